@@ -0,0 +1,660 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// two-level segregated fit (tlsf) sub-allocator over a linear range of offsets. allocate and free are o(1): free ranges
+// are bucketed by size class, bitmaps find the first non-empty bucket that is large enough, and neighbours merge on free.
+//
+// it knows nothing about vulkan and only hands out offsets, so one instance manages one VkDeviceMemory block.
+class TlsfAllocator {
+public:
+    static constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+
+    struct Range {
+        uint64_t offset;
+        uint32_t node;
+    };
+
+    explicit TlsfAllocator(uint64_t size) : capacity(size) {
+        uint32_t node = createNode(0, roundDown(size));
+        insertFree(node);
+    }
+
+    uint64_t size() const {
+        return capacity;
+    }
+
+    uint64_t usedBytes() const {
+        return used;
+    }
+
+    bool empty() const {
+        return used == 0;
+    }
+
+    // returns a range with node == NO_NODE when no free range can fit the request.
+    Range allocate(uint64_t size, uint64_t alignment) {
+        alignment = std::max<uint64_t>(alignment, MIN_ALIGNMENT);
+        size = roundUp(size);
+
+        // searching for size + alignment - 1 guarantees any range found can be aligned without a second search.
+        uint64_t searchSize = size + alignment - MIN_ALIGNMENT;
+        uint32_t node = findFree(searchSize);
+        if (node == NO_NODE) {
+            return {0, NO_NODE};
+        }
+        removeFree(node);
+
+        uint64_t alignedOffset = (nodes[node].offset + alignment - 1) / alignment * alignment;
+        uint64_t padding = alignedOffset - nodes[node].offset;
+
+        // the range before a used range is never free, so the padding becomes a free range of its own.
+        if (padding > 0) {
+            uint32_t front = createNode(nodes[node].offset, padding);
+            linkBefore(front, node);
+            nodes[node].offset += padding;
+            nodes[node].size -= padding;
+            insertFree(front);
+        }
+
+        if (nodes[node].size > size) {
+            uint32_t back = createNode(nodes[node].offset + size, nodes[node].size - size);
+            linkAfter(back, node);
+            nodes[node].size = size;
+            insertFree(back);
+        }
+
+        nodes[node].free = false;
+        used += nodes[node].size;
+        return {nodes[node].offset, node};
+    }
+
+    void free(uint32_t node) {
+        used -= nodes[node].size;
+        nodes[node].free = true;
+
+        uint32_t prev = nodes[node].prevPhysical;
+        if (prev != NO_NODE && nodes[prev].free) {
+            removeFree(prev);
+            nodes[prev].size += nodes[node].size;
+            unlink(node);
+            releaseNode(node);
+            node = prev;
+        }
+
+        uint32_t next = nodes[node].nextPhysical;
+        if (next != NO_NODE && nodes[next].free) {
+            removeFree(next);
+            nodes[node].size += nodes[next].size;
+            unlink(next);
+            releaseNode(next);
+        }
+
+        insertFree(node);
+    }
+
+private:
+    static constexpr uint64_t MIN_ALIGNMENT = 8;
+    static constexpr uint32_t SECOND_LEVEL_LOG2 = 5;
+    static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_LOG2;
+    // every size below 2^SMALL_LOG2 lives in first level 0, split into exact MIN_ALIGNMENT-wide buckets.
+    static constexpr uint32_t SMALL_LOG2 = 8;
+    static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SMALL_LOG2 + 1;
+
+    struct Node {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+        uint32_t prevFree;
+        uint32_t nextFree;
+        bool free;
+    };
+
+    uint64_t capacity;
+    uint64_t used = 0;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+
+    uint64_t firstLevelBitmap = 0;
+    std::array<uint32_t, FIRST_LEVEL_COUNT> secondLevelBitmaps{};
+    std::array<std::array<uint32_t, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> freeLists = makeEmptyLists();
+
+    static std::array<std::array<uint32_t, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> makeEmptyLists() {
+        std::array<std::array<uint32_t, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> lists;
+        for (auto& list : lists) {
+            list.fill(NO_NODE);
+        }
+        return lists;
+    }
+
+    static uint64_t roundUp(uint64_t size) {
+        return (size + MIN_ALIGNMENT - 1) / MIN_ALIGNMENT * MIN_ALIGNMENT;
+    }
+
+    static uint64_t roundDown(uint64_t size) {
+        return size / MIN_ALIGNMENT * MIN_ALIGNMENT;
+    }
+
+    static uint32_t mostSignificantBit(uint64_t value) {
+        uint32_t bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+    }
+
+    static uint32_t leastSignificantBit(uint64_t value) {
+        uint32_t bit = 0;
+        while ((value & 1) == 0) {
+            value >>= 1;
+            bit++;
+        }
+        return bit;
+    }
+
+    static void mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+        if (size < (uint64_t(1) << SMALL_LOG2)) {
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size / MIN_ALIGNMENT);
+            return;
+        }
+
+        uint32_t msb = mostSignificantBit(size);
+        firstLevel = msb - SMALL_LOG2 + 1;
+        secondLevel = static_cast<uint32_t>((size >> (msb - SECOND_LEVEL_LOG2)) ^ SECOND_LEVEL_COUNT);
+    }
+
+    uint32_t findFree(uint64_t size) {
+        // round up to the next bucket boundary so every range in the chosen bucket is at least as large as the request.
+        if (size >= (uint64_t(1) << SMALL_LOG2)) {
+            size += (uint64_t(1) << (mostSignificantBit(size) - SECOND_LEVEL_LOG2)) - 1;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        mapping(size, firstLevel, secondLevel);
+        if (firstLevel >= FIRST_LEVEL_COUNT) {
+            return NO_NODE;
+        }
+
+        uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if (secondLevelMap == 0) {
+            uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+            if (firstLevelMap == 0) {
+                return NO_NODE;
+            }
+
+            firstLevel = leastSignificantBit(firstLevelMap);
+            secondLevelMap = secondLevelBitmaps[firstLevel];
+        }
+
+        secondLevel = leastSignificantBit(secondLevelMap);
+        return freeLists[firstLevel][secondLevel];
+    }
+
+    void insertFree(uint32_t node) {
+        uint32_t firstLevel, secondLevel;
+        mapping(nodes[node].size, firstLevel, secondLevel);
+
+        uint32_t head = freeLists[firstLevel][secondLevel];
+        nodes[node].free = true;
+        nodes[node].prevFree = NO_NODE;
+        nodes[node].nextFree = head;
+        if (head != NO_NODE) {
+            nodes[head].prevFree = node;
+        }
+        freeLists[firstLevel][secondLevel] = node;
+
+        firstLevelBitmap |= uint64_t(1) << firstLevel;
+        secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    }
+
+    void removeFree(uint32_t node) {
+        uint32_t firstLevel, secondLevel;
+        mapping(nodes[node].size, firstLevel, secondLevel);
+
+        uint32_t prev = nodes[node].prevFree;
+        uint32_t next = nodes[node].nextFree;
+        if (prev != NO_NODE) {
+            nodes[prev].nextFree = next;
+        } else {
+            freeLists[firstLevel][secondLevel] = next;
+        }
+        if (next != NO_NODE) {
+            nodes[next].prevFree = prev;
+        }
+
+        if (freeLists[firstLevel][secondLevel] == NO_NODE) {
+            secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (secondLevelBitmaps[firstLevel] == 0) {
+                firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+            }
+        }
+    }
+
+    uint32_t createNode(uint64_t offset, uint64_t size) {
+        Node node{offset, size, NO_NODE, NO_NODE, NO_NODE, NO_NODE, true};
+
+        if (!unusedNodes.empty()) {
+            uint32_t index = unusedNodes.back();
+            unusedNodes.pop_back();
+            nodes[index] = node;
+            return index;
+        }
+
+        nodes.push_back(node);
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void releaseNode(uint32_t node) {
+        unusedNodes.push_back(node);
+    }
+
+    void linkBefore(uint32_t node, uint32_t next) {
+        uint32_t prev = nodes[next].prevPhysical;
+        nodes[node].prevPhysical = prev;
+        nodes[node].nextPhysical = next;
+        nodes[next].prevPhysical = node;
+        if (prev != NO_NODE) {
+            nodes[prev].nextPhysical = node;
+        }
+    }
+
+    void linkAfter(uint32_t node, uint32_t prev) {
+        uint32_t next = nodes[prev].nextPhysical;
+        nodes[node].prevPhysical = prev;
+        nodes[node].nextPhysical = next;
+        nodes[prev].nextPhysical = node;
+        if (next != NO_NODE) {
+            nodes[next].prevPhysical = node;
+        }
+    }
+
+    void unlink(uint32_t node) {
+        uint32_t prev = nodes[node].prevPhysical;
+        uint32_t next = nodes[node].nextPhysical;
+        if (prev != NO_NODE) {
+            nodes[prev].nextPhysical = next;
+        }
+        if (next != NO_NODE) {
+            nodes[next].prevPhysical = prev;
+        }
+    }
+};
+
+// whether a resource is laid out linearly (buffers, linear images) or opaquely (optimal-tiling images). the two kinds are
+// kept in separate blocks so bufferImageGranularity never forces padding between neighbours.
+enum class ResourceKind : uint32_t {
+    Linear,
+    Optimal
+};
+
+struct GpuAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // non-null when the memory type is host visible; blocks stay mapped for their whole lifetime.
+    void* mapped = nullptr;
+
+    uint32_t memoryType = 0;
+    uint32_t pool = 0;
+    uint32_t block = 0;
+    uint32_t node = TlsfAllocator::NO_NODE;
+    bool dedicated = false;
+};
+
+struct GpuAllocatorStats {
+    uint64_t blockCount = 0;
+    uint64_t blockBytes = 0;
+    uint64_t usedBytes = 0;
+    uint64_t allocationCount = 0;
+    uint64_t dedicatedCount = 0;
+    uint64_t dedicatedBytes = 0;
+    // total vkAllocateMemory calls ever made, which is what maxMemoryAllocationCount limits.
+    uint64_t deviceAllocationCount = 0;
+    // total sub-allocations and dedicated allocations ever handed out.
+    uint64_t totalAllocationCount = 0;
+};
+
+// hands out sub-ranges of large per-memory-type VkDeviceMemory blocks instead of one vkAllocateMemory per resource.
+// resources larger than half a block get a dedicated allocation of their own.
+class GpuAllocator {
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice) {
+        this->device = device;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        bufferImageGranularity = properties.limits.bufferImageGranularity;
+        nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+        maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+        pools.resize(memoryProperties.memoryTypeCount * 2);
+    }
+
+    void cleanup() {
+        for (auto& pool : pools) {
+            for (auto& block : pool.blocks) {
+                if (block.memory != VK_NULL_HANDLE) {
+                    vkFreeMemory(device, block.memory, nullptr);
+                }
+            }
+            pool.blocks.clear();
+        }
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    bool hasMemoryType(VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isHostVisible(uint32_t memoryType) const {
+        return (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    bool isHostCoherent(uint32_t memoryType) const {
+        return (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+
+    GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind) {
+        uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+        VkDeviceSize blockSize = preferredBlockSize(memoryType);
+
+        if (requirements.size > blockSize / 2) {
+            return allocateDedicated(requirements.size, memoryType);
+        }
+
+        // with a granularity of 1 linear and optimal resources can share blocks without any padding.
+        uint32_t poolIndex = memoryType * 2;
+        if (bufferImageGranularity > 1 && kind == ResourceKind::Optimal) {
+            poolIndex++;
+        }
+        Pool& pool = pools[poolIndex];
+
+        for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+            Block& block = pool.blocks[i];
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            TlsfAllocator::Range range = block.allocator->allocate(requirements.size, requirements.alignment);
+            if (range.node != TlsfAllocator::NO_NODE) {
+                return makeAllocation(block, memoryType, poolIndex, i, range, requirements.size);
+            }
+        }
+
+        uint32_t blockIndex = createBlock(pool, memoryType, blockSize);
+        Block& block = pool.blocks[blockIndex];
+
+        TlsfAllocator::Range range = block.allocator->allocate(requirements.size, requirements.alignment);
+        if (range.node == TlsfAllocator::NO_NODE) {
+            throw std::runtime_error("failed to sub-allocate from a new memory block!");
+        }
+        return makeAllocation(block, memoryType, poolIndex, blockIndex, range, requirements.size);
+    }
+
+    void free(GpuAllocation& allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+
+        if (allocation.dedicated) {
+            vkFreeMemory(device, allocation.memory, nullptr);
+            stats.dedicatedCount--;
+            stats.dedicatedBytes -= allocation.size;
+            allocation = GpuAllocation{};
+            return;
+        }
+
+        Pool& pool = pools[allocation.pool];
+        Block& block = pool.blocks[allocation.block];
+        block.allocator->free(allocation.node);
+        stats.allocationCount--;
+        stats.usedBytes -= allocation.size;
+
+        // keep one empty block per pool around so a free/allocate pair on the boundary does not thrash vkAllocateMemory.
+        if (block.allocator->empty()) {
+            if (pool.emptyBlocks > 0) {
+                destroyBlock(pool, allocation.block);
+            } else {
+                block.countedEmpty = true;
+                pool.emptyBlocks++;
+            }
+        }
+
+        allocation = GpuAllocation{};
+    }
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        allocation = allocate(memRequirements, properties, ResourceKind::Linear);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& allocation) {
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+        ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+        allocation = allocate(memRequirements, properties, kind);
+        vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    }
+
+    void destroyBuffer(VkBuffer buffer, GpuAllocation& allocation) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        free(allocation);
+    }
+
+    void destroyImage(VkImage image, GpuAllocation& allocation) {
+        vkDestroyImage(device, image, nullptr);
+        free(allocation);
+    }
+
+    // makes host writes visible to the device on memory types that are not host coherent. a no-op otherwise.
+    void flush(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+        if (isHostCoherent(allocation.memoryType)) {
+            return;
+        }
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = alignDown(allocation.offset + offset, nonCoherentAtomSize);
+        range.size = size == VK_WHOLE_SIZE ? VK_WHOLE_SIZE : alignUp(allocation.offset + offset + size, nonCoherentAtomSize) - range.offset;
+        vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    // makes device writes visible to the host on memory types that are not host coherent. a no-op otherwise.
+    void invalidate(const GpuAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+        if (isHostCoherent(allocation.memoryType)) {
+            return;
+        }
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = alignDown(allocation.offset + offset, nonCoherentAtomSize);
+        range.size = size == VK_WHOLE_SIZE ? VK_WHOLE_SIZE : alignUp(allocation.offset + offset + size, nonCoherentAtomSize) - range.offset;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    const GpuAllocatorStats& getStats() const {
+        return stats;
+    }
+
+    void printStats() const {
+        std::cout << "gpu memory: " << stats.allocationCount << " sub-allocations using "
+                  << stats.usedBytes / 1024 << " KiB of " << stats.blockBytes / 1024 << " KiB in " << stats.blockCount << " blocks, "
+                  << stats.dedicatedCount << " dedicated (" << stats.dedicatedBytes / 1024 << " KiB), "
+                  << stats.deviceAllocationCount << " vkAllocateMemory calls (limit " << maxMemoryAllocationCount << ")" << std::endl;
+    }
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        std::unique_ptr<TlsfAllocator> allocator;
+        bool countedEmpty = false;
+    };
+
+    struct Pool {
+        std::vector<Block> blocks;
+        std::vector<uint32_t> freeBlockSlots;
+        uint32_t emptyBlocks = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize bufferImageGranularity = 1;
+    VkDeviceSize nonCoherentAtomSize = 1;
+    uint32_t maxMemoryAllocationCount = 0;
+
+    // two pools per memory type: linear resources first, then optimal images.
+    std::vector<Pool> pools;
+    GpuAllocatorStats stats;
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+        return value / alignment * alignment;
+    }
+
+    // small heaps (integrated gpus, the 256 MiB host-visible device-local window) get proportionally smaller blocks.
+    VkDeviceSize preferredBlockSize(uint32_t memoryType) const {
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        return std::min(DEFAULT_BLOCK_SIZE, alignUp(heapSize / 8, 1024 * 1024));
+    }
+
+    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+        stats.deviceAllocationCount++;
+
+        *mapped = nullptr;
+        if (isHostVisible(memoryType) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            throw std::runtime_error("failed to map device memory!");
+        }
+
+        return memory;
+    }
+
+    GpuAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryType) {
+        GpuAllocation allocation;
+        allocation.memory = allocateMemory(size, memoryType, &allocation.mapped);
+        allocation.size = size;
+        allocation.memoryType = memoryType;
+        allocation.dedicated = true;
+
+        stats.dedicatedCount++;
+        stats.totalAllocationCount++;
+        stats.dedicatedBytes += size;
+        return allocation;
+    }
+
+    uint32_t createBlock(Pool& pool, uint32_t memoryType, VkDeviceSize size) {
+        Block block;
+        block.memory = allocateMemory(size, memoryType, &block.mapped);
+        block.size = size;
+        block.allocator = std::make_unique<TlsfAllocator>(size);
+
+        stats.blockCount++;
+        stats.blockBytes += size;
+
+        if (!pool.freeBlockSlots.empty()) {
+            uint32_t index = pool.freeBlockSlots.back();
+            pool.freeBlockSlots.pop_back();
+            pool.blocks[index] = std::move(block);
+            return index;
+        }
+
+        pool.blocks.push_back(std::move(block));
+        return static_cast<uint32_t>(pool.blocks.size() - 1);
+    }
+
+    void destroyBlock(Pool& pool, uint32_t blockIndex) {
+        Block& block = pool.blocks[blockIndex];
+        vkFreeMemory(device, block.memory, nullptr);
+        stats.blockCount--;
+        stats.blockBytes -= block.size;
+
+        block = Block{};
+        pool.freeBlockSlots.push_back(blockIndex);
+    }
+
+    GpuAllocation makeAllocation(Block& block, uint32_t memoryType, uint32_t poolIndex, uint32_t blockIndex, TlsfAllocator::Range range, VkDeviceSize size) {
+        if (block.countedEmpty) {
+            block.countedEmpty = false;
+            pools[poolIndex].emptyBlocks--;
+        }
+
+        GpuAllocation allocation;
+        allocation.memory = block.memory;
+        allocation.offset = range.offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + range.offset : nullptr;
+        allocation.memoryType = memoryType;
+        allocation.pool = poolIndex;
+        allocation.block = blockIndex;
+        allocation.node = range.node;
+
+        stats.allocationCount++;
+        stats.totalAllocationCount++;
+        stats.usedBytes += size;
+        return allocation;
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// the scripted scenes of the frame benchmark suite. each renders headless for a fixed number of frames, animated by
+// frame number, so two runs on the same machine and driver draw exactly the same thing.
+enum class BenchmarkScene : uint32_t {
+    // the single triangle: mostly fixed per-frame overhead.
+    Triangle,
+    // the grouped instanced scene, with its instance data rewritten on the CPU every frame.
+    Instances,
+    // the triangle plus several megabytes pushed through the upload path every frame.
+    Upload,
+    // many draws of the triangle, each binding a different pipeline variant.
+    PipelineChurn,
+    Count
+};
+
+const uint32_t BENCHMARK_SCENE_COUNT = static_cast<uint32_t>(BenchmarkScene::Count);
+
+inline const char* benchmarkSceneName(BenchmarkScene scene) {
+    static const char* names[BENCHMARK_SCENE_COUNT] = {"triangle", "instances", "upload", "pipeline-churn"};
+    return names[static_cast<uint32_t>(scene)];
+}
+
+inline bool parseBenchmarkScene(const std::string& name, BenchmarkScene& scene) {
+    for (uint32_t i = 0; i < BENCHMARK_SCENE_COUNT; i++) {
+        if (name == benchmarkSceneName(static_cast<BenchmarkScene>(i))) {
+            scene = static_cast<BenchmarkScene>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// parses a comma-separated list of scene names, or "all".
+inline bool parseBenchmarkScenes(const std::string& list, std::vector<BenchmarkScene>& scenes) {
+    scenes.clear();
+    std::stringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name == "all") {
+            for (uint32_t i = 0; i < BENCHMARK_SCENE_COUNT; i++) {
+                scenes.push_back(static_cast<BenchmarkScene>(i));
+            }
+            continue;
+        }
+        BenchmarkScene scene;
+        if (!parseBenchmarkScene(name, scene)) {
+            return false;
+        }
+        scenes.push_back(scene);
+    }
+    return !scenes.empty();
+}
+
+struct BenchmarkSettings {
+    std::vector<BenchmarkScene> scenes;
+    // untimed frames before the first repetition, so caches, pools and the pipeline compiler have settled.
+    uint32_t warmupFrames = 100;
+    uint32_t frames = 500;
+    uint32_t repetitions = 5;
+    std::string outputPath = "benchmark.json";
+};
+
+// one timed repetition of a scene.
+struct BenchmarkRun {
+    // wall time of each pass through the frame loop, waits included: what limits throughput.
+    std::vector<double> frameMs;
+    // cpu time spent recording and submitting each frame, from the profiler.
+    std::vector<double> cpuMs;
+    // gpu time of each frame; empty when the queue has no timestamps.
+    std::vector<double> gpuMs;
+    // gpu memory sub-allocations and vkAllocateMemory calls made during the repetition.
+    uint64_t allocations = 0;
+    uint64_t deviceAllocations = 0;
+};
+
+struct BenchmarkResult {
+    BenchmarkScene scene = BenchmarkScene::Triangle;
+    std::string deviceName;
+    uint32_t drawsPerFrame = 0;
+    std::vector<BenchmarkRun> runs;
+};
+
+// mean, spread and percentiles of a set of frame times, pooled over every repetition.
+struct BenchmarkDistribution {
+    double mean = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    // standard deviation of the per-repetition means, which shows how far apart repetitions landed.
+    double repetitionStddev = 0.0;
+
+    static BenchmarkDistribution of(const std::vector<BenchmarkRun>& runs, std::vector<double> BenchmarkRun::*times) {
+        BenchmarkDistribution distribution;
+        std::vector<double> pooled;
+        std::vector<double> means;
+        for (const auto& run : runs) {
+            const std::vector<double>& values = run.*times;
+            if (values.empty()) {
+                continue;
+            }
+            double total = 0.0;
+            for (double value : values) {
+                total += value;
+            }
+            means.push_back(total / values.size());
+            pooled.insert(pooled.end(), values.begin(), values.end());
+        }
+        if (pooled.empty()) {
+            return distribution;
+        }
+
+        double total = 0.0;
+        for (double value : pooled) {
+            total += value;
+        }
+        distribution.mean = total / pooled.size();
+        distribution.min = *std::min_element(pooled.begin(), pooled.end());
+        distribution.max = *std::max_element(pooled.begin(), pooled.end());
+        distribution.p50 = FrameProfiler::percentile(pooled, 0.50);
+        distribution.p95 = FrameProfiler::percentile(pooled, 0.95);
+        distribution.p99 = FrameProfiler::percentile(pooled, 0.99);
+
+        double meanOfMeans = 0.0;
+        for (double mean : means) {
+            meanOfMeans += mean;
+        }
+        meanOfMeans /= means.size();
+        double variance = 0.0;
+        for (double mean : means) {
+            variance += (mean - meanOfMeans) * (mean - meanOfMeans);
+        }
+        distribution.repetitionStddev = std::sqrt(variance / means.size());
+        return distribution;
+    }
+
+    void writeJson(std::ostream& out) const {
+        out << "{\"mean\": " << mean << ", \"min\": " << min << ", \"p50\": " << p50 << ", \"p95\": " << p95
+            << ", \"p99\": " << p99 << ", \"max\": " << max << ", \"repetition_stddev\": " << repetitionStddev << "}";
+    }
+};
+
+inline std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// one line per scene for the console.
+inline void printBenchmarkResult(const BenchmarkResult& result) {
+    BenchmarkDistribution frame = BenchmarkDistribution::of(result.runs, &BenchmarkRun::frameMs);
+    BenchmarkDistribution gpu = BenchmarkDistribution::of(result.runs, &BenchmarkRun::gpuMs);
+    std::cout << std::setw(15) << benchmarkSceneName(result.scene) << ": frame p50 " << frame.p50 << " ms, p99 " << frame.p99
+              << " ms";
+    if (gpu.max > 0.0) {
+        std::cout << ", gpu p50 " << gpu.p50 << " ms";
+    }
+    std::cout << " (+/- " << frame.repetitionStddev << " ms over " << result.runs.size() << " repetitions)" << std::endl;
+}
+
+inline bool writeBenchmarkReport(const std::string& path, const BenchmarkSettings& settings, const std::vector<BenchmarkResult>& results) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string deviceName = results.empty() ? "" : results.front().deviceName;
+    file << "{\n  \"device\": \"" << jsonEscape(deviceName) << "\",\n"
+         << "  \"warmup_frames\": " << settings.warmupFrames << ",\n"
+         << "  \"frames\": " << settings.frames << ",\n"
+         << "  \"repetitions\": " << settings.repetitions << ",\n"
+         << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        uint64_t allocations = 0;
+        uint64_t deviceAllocations = 0;
+        for (const auto& run : result.runs) {
+            allocations += run.allocations;
+            deviceAllocations += run.deviceAllocations;
+        }
+
+        file << "    {\"name\": \"" << benchmarkSceneName(result.scene) << "\", \"draws_per_frame\": " << result.drawsPerFrame
+             << ",\n     \"frame_ms\": ";
+        BenchmarkDistribution::of(result.runs, &BenchmarkRun::frameMs).writeJson(file);
+        file << ",\n     \"cpu_ms\": ";
+        BenchmarkDistribution::of(result.runs, &BenchmarkRun::cpuMs).writeJson(file);
+        file << ",\n     \"gpu_ms\": ";
+        bool hasGpu = std::any_of(result.runs.begin(), result.runs.end(), [](const BenchmarkRun& run) { return !run.gpuMs.empty(); });
+        if (hasGpu) {
+            BenchmarkDistribution::of(result.runs, &BenchmarkRun::gpuMs).writeJson(file);
+        } else {
+            file << "null";
+        }
+        file << ",\n     \"allocations\": " << allocations << ", \"device_allocations\": " << deviceAllocations << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// hands out slots of a fixed-size descriptor array. a released slot only becomes free again once every frame that
+// could still have been using it has finished, so an in-flight frame never sees its descriptor rewritten underneath it.
+class SlotAllocator {
+public:
+    void init(uint32_t capacity, uint32_t framesInFlight) {
+        this->capacity = capacity;
+        next = 0;
+        freeSlots.clear();
+        retired.assign(framesInFlight, {});
+    }
+
+    uint32_t allocate() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (next == capacity) {
+            throw std::runtime_error("bindless descriptor array is full!");
+        }
+        return next++;
+    }
+
+    // retires the slot with the frame being recorded in frameSlot.
+    void release(uint32_t frameSlot, uint32_t slot) {
+        retired[frameSlot].push_back(slot);
+    }
+
+    // the slot's previous frame has finished, so everything it retired can be handed out again.
+    void beginFrame(uint32_t frameSlot) {
+        freeSlots.insert(freeSlots.end(), retired[frameSlot].begin(), retired[frameSlot].end());
+        retired[frameSlot].clear();
+    }
+
+    uint32_t used() const {
+        uint32_t pending = 0;
+        for (const auto& slots : retired) {
+            pending += static_cast<uint32_t>(slots.size());
+        }
+        return next - static_cast<uint32_t>(freeSlots.size()) - pending;
+    }
+
+    uint32_t size() const {
+        return capacity;
+    }
+
+private:
+    uint32_t capacity = 0;
+    uint32_t next = 0;
+    std::vector<uint32_t> freeSlots;
+    std::vector<std::vector<uint32_t>> retired;
+};
+
+// index of a resource in the bindless arrays, as shaders receive it through push constants or instance data.
+struct BindlessHandle {
+    static constexpr uint32_t INVALID = UINT32_MAX;
+    uint32_t index = INVALID;
+
+    bool valid() const {
+        return index != INVALID;
+    }
+};
+
+// one descriptor set holding every image and storage buffer the renderer uses, in large arrays.
+//
+// the set is bound once per command buffer and never changes, so draws that only differ in the resources they read can
+// be merged; shaders pick their resources by index. the arrays are update-after-bind and partially bound, so new
+// resources are written while frames using the set are still in flight, and unused slots need no valid descriptor.
+// buffers come in two arrays: per-draw buffers such as materials, indexed non-uniformly, and tables every invocation of
+// a draw indexes the same way, such as the texture streamer's residency table of the frame.
+class BindlessHeap {
+public:
+    static constexpr uint32_t IMAGE_BINDING = 0;
+    static constexpr uint32_t BUFFER_BINDING = 1;
+    static constexpr uint32_t TABLE_BINDING = 2;
+    static constexpr uint32_t DEFAULT_IMAGE_CAPACITY = 4096;
+    static constexpr uint32_t DEFAULT_BUFFER_CAPACITY = 1024;
+    static constexpr uint32_t DEFAULT_TABLE_CAPACITY = 16;
+
+    // the device must have been created with runtimeDescriptorArray, descriptorBindingPartiallyBound, the
+    // update-after-bind and non-uniform indexing features for sampled images and storage buffers, and
+    // shaderStorageBufferArrayDynamicIndexing for the tables.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight,
+              uint32_t imageCapacity = DEFAULT_IMAGE_CAPACITY, uint32_t bufferCapacity = DEFAULT_BUFFER_CAPACITY,
+              uint32_t tableCapacity = DEFAULT_TABLE_CAPACITY) {
+        this->device = device;
+
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        imageCapacity = std::min({imageCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                  indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+        // both buffer arrays count against the same storage buffer limits.
+        uint32_t storageBufferLimit = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                               indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+        tableCapacity = std::min(tableCapacity, storageBufferLimit / 2);
+        bufferCapacity = std::min(bufferCapacity, storageBufferLimit - tableCapacity);
+        images.init(imageCapacity, framesInFlight);
+        buffers.init(bufferCapacity, framesInFlight);
+        tables.init(tableCapacity, framesInFlight);
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+        bindings[0].binding = IMAGE_BINDING;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = imageCapacity;
+        bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[1].binding = BUFFER_BINDING;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = bufferCapacity;
+        bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+        bindings[2].binding = TABLE_BINDING;
+        bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[2].descriptorCount = tableCapacity;
+        bindings[2].stageFlags = VK_SHADER_STAGE_ALL;
+
+        VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                         VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        std::array<VkDescriptorBindingFlags, 3> bindingFlags = {flags, flags, flags};
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor set layout!");
+        }
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCapacity},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity + tableCapacity},
+        }};
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+        }
+    }
+
+    void cleanup() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        device = VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetLayout setLayout() const {
+        return layout;
+    }
+
+    VkDescriptorSet descriptorSet() const {
+        return set;
+    }
+
+    // recycles the slots released by the frame slot's previous frame. the caller must have waited for that frame.
+    void beginFrame(uint32_t frame) {
+        currentFrame = frame;
+        images.beginFrame(frame);
+        buffers.beginFrame(frame);
+        tables.beginFrame(frame);
+    }
+
+    BindlessHandle addImage(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+        BindlessHandle handle{images.allocate()};
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler = sampler;
+        imageInfo.imageView = view;
+        imageInfo.imageLayout = layout;
+        write(IMAGE_BINDING, handle, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &imageInfo, nullptr);
+
+        return handle;
+    }
+
+    BindlessHandle addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+        BindlessHandle handle{buffers.allocate()};
+
+        VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+        write(BUFFER_BINDING, handle, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &bufferInfo);
+
+        return handle;
+    }
+
+    // a table's handle must be the same for every invocation of a draw.
+    BindlessHandle addTable(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+        BindlessHandle handle{tables.allocate()};
+
+        VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+        write(TABLE_BINDING, handle, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &bufferInfo);
+
+        return handle;
+    }
+
+    // the resource may be destroyed once no frame recorded before this call can still be running.
+    void releaseImage(BindlessHandle handle) {
+        images.release(currentFrame, handle.index);
+    }
+
+    void releaseBuffer(BindlessHandle handle) {
+        buffers.release(currentFrame, handle.index);
+    }
+
+    void releaseTable(BindlessHandle handle) {
+        tables.release(currentFrame, handle.index);
+    }
+
+    void printStats() const {
+        std::cout << "bindless: " << images.used() << " of " << images.size() << " images, " << buffers.used() << " of "
+                  << buffers.size() << " buffers, " << tables.used() << " of " << tables.size() << " tables" << std::endl;
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    SlotAllocator images;
+    SlotAllocator buffers;
+    SlotAllocator tables;
+    uint32_t currentFrame = 0;
+
+    void write(uint32_t binding, BindlessHandle handle, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo,
+               const VkDescriptorBufferInfo* bufferInfo) {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.dstArrayElement = handle.index;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = type;
+        descriptorWrite.pImageInfo = imageInfo;
+        descriptorWrite.pBufferInfo = bufferInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat : uint32_t {
+    Raw,
+    Png
+};
+
+struct CaptureSettings {
+    // where captured frames are written; empty to only compare them.
+    std::string directory;
+    CaptureFormat format = CaptureFormat::Png;
+    // raw frames of a previous capture to compare against; empty to not compare.
+    std::string goldenDirectory;
+    // largest per-channel difference from the golden frame that still counts as equal.
+    uint32_t tolerance = 0;
+};
+
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// writes an 8-bit RGBA png. the image data goes into stored (uncompressed) deflate blocks: files are large, but
+// encoding costs no more than a copy, which is what keeps a capture worker ahead of the frame rate.
+inline bool writePng(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba) {
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    auto put32 = [](std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    };
+    auto chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+        put32(png, static_cast<uint32_t>(data.size()));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        put32(png, crc32(png.data() + start, png.size() - start));
+    };
+
+    std::vector<uint8_t> header;
+    put32(header, width);
+    put32(header, height);
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    chunk("IHDR", header);
+
+    // every row starts with filter type 0.
+    size_t rowBytes = size_t(width) * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + y * rowBytes, rgba.begin() + (y + 1) * rowBytes);
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    const size_t MAX_STORED_BLOCK = 65535;
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += MAX_STORED_BLOCK) {
+        size_t length = std::min(MAX_STORED_BLOCK, raw.size() - offset);
+        bool last = offset + length >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        if (last) {
+            break;
+        }
+    }
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    put32(zlib, (b << 16) | a);
+    chunk("IDAT", zlib);
+    chunk("IEND", {});
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+    return static_cast<bool>(file);
+}
+
+// copies rendered frames back to the CPU and streams them to disk or compares them with golden frames.
+//
+// each frame slot has its own host-visible readback buffer. cmdCapture() records the copy into the frame's command
+// buffer, and collect() picks the pixels up once the slot's wait for that frame has returned, so capturing never waits
+// on the GPU beyond what frame pacing already does and adds no frame of latency. converting and writing happen on a
+// worker thread; if it falls behind, frames are dropped rather than stalling the loop, except when comparing against
+// goldens, where every frame matters.
+class FrameCapture {
+public:
+    static constexpr size_t MAX_QUEUED_FRAMES = 8;
+    static constexpr size_t MAX_REPORTED_MISMATCHES = 8;
+
+    // the copy is taken as-is, so only four-byte rgba and bgra formats can be written out.
+    static bool supportsFormat(VkFormat format) {
+        return rgbaFormat(format) || bgraFormat(format);
+    }
+
+    void init(GpuAllocator& allocator, uint32_t framesInFlight, const CaptureSettings& settings) {
+        this->allocator = &allocator;
+        this->settings = settings;
+        slots.assign(framesInFlight, Slot{});
+
+        // the CPU reads every byte back, which is many times faster from cached memory.
+        readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if (!allocator.hasMemoryType(readbackProperties)) {
+            readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+
+        stopping = false;
+        worker = std::thread([this]() { workerLoop(); });
+    }
+
+    // the caller must have collected every slot, with the device idle.
+    void cleanup() {
+        if (allocator == nullptr) {
+            return;
+        }
+
+        finish();
+        for (auto& slot : slots) {
+            if (slot.buffer != VK_NULL_HANDLE) {
+                allocator->destroyBuffer(slot.buffer, slot.memory);
+            }
+        }
+        slots.clear();
+        allocator = nullptr;
+    }
+
+    bool active() const {
+        return allocator != nullptr;
+    }
+
+    // records a copy of image into the slot's readback buffer. image is in layout, and is left in it; the barrier or
+    // render pass dependency that put it there must have made the rendering visible to transfer reads, as the copy only
+    // waits for the transfer stage. outside a render pass; the slot's previous capture must be collected.
+    void cmdCapture(VkCommandBuffer commandBuffer, uint32_t slotIndex, uint64_t frameNumber, VkImage image, VkFormat format,
+                    VkExtent2D extent, VkImageLayout layout) {
+        Slot& slot = slots[slotIndex];
+        VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+        if (slot.capacity < size) {
+            if (slot.buffer != VK_NULL_HANDLE) {
+                allocator->destroyBuffer(slot.buffer, slot.memory);
+            }
+            allocator->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackProperties, slot.buffer, slot.memory);
+            slot.capacity = size;
+        }
+
+        // only the layout changes; the writes are already visible to the copy.
+        VkImageMemoryBarrier toTransfer{};
+        toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransfer.srcAccessMask = 0;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        toTransfer.oldLayout = layout;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.image = image;
+        toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 0, nullptr, 0, nullptr, 1, &toTransfer);
+        }
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageExtent = {extent.width, extent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+        VkBufferMemoryBarrier toHost{};
+        toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.buffer = slot.buffer;
+        toHost.size = size;
+
+        // presentation is ordered by the submit's semaphore, so going back needs no wait on anything later.
+        VkImageMemoryBarrier back = toTransfer;
+        back.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        back.dstAccessMask = 0;
+        back.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        back.newLayout = layout;
+        uint32_t imageBarrierCount = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 1 : 0;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 1, &toHost, imageBarrierCount, &back);
+
+        slot.pending = true;
+        slot.frameNumber = frameNumber;
+        slot.width = extent.width;
+        slot.height = extent.height;
+        slot.bgra = bgraFormat(format);
+        captured++;
+    }
+
+    // hands the slot's capture to the worker. the caller must have waited for the frame that recorded it.
+    void collect(uint32_t slotIndex) {
+        Slot& slot = slots[slotIndex];
+        if (!slot.pending) {
+            return;
+        }
+        slot.pending = false;
+
+        bool keepEvery = !settings.goldenDirectory.empty();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (queue.size() >= MAX_QUEUED_FRAMES) {
+                if (!keepEvery) {
+                    dropped++;
+                    return;
+                }
+                drained.wait(lock, [this]() { return queue.size() < MAX_QUEUED_FRAMES; });
+            }
+        }
+
+        // the copy is made outside the lock so the worker is never held up by it.
+        size_t size = size_t(slot.width) * slot.height * 4;
+        allocator->invalidate(slot.memory, 0, size);
+
+        Frame frame;
+        frame.number = slot.frameNumber;
+        frame.width = slot.width;
+        frame.height = slot.height;
+        frame.bgra = slot.bgra;
+        const uint8_t* mapped = static_cast<const uint8_t*>(slot.memory.mapped);
+        frame.pixels.assign(mapped, mapped + size);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(frame));
+        }
+        ready.notify_one();
+    }
+
+    // blocks until the worker has written and compared every frame handed to it.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // true once any compared frame differed from its golden frame or had none.
+    bool failed() const {
+        return mismatched > 0 || missingGoldens > 0;
+    }
+
+    void printStats() const {
+        std::cout << "capture: " << captured << " frames captured, " << written << " written, " << dropped << " dropped";
+        if (processed > 0) {
+            std::cout << ", avg " << workerMs / processed << " ms per frame on the worker";
+        }
+        std::cout << std::endl;
+
+        if (!settings.goldenDirectory.empty()) {
+            std::cout << "golden: " << compared << " frames compared, " << mismatched << " differ, " << missingGoldens
+                      << " missing, max channel difference " << maxDifference << " (tolerance " << settings.tolerance << ")"
+                      << std::endl;
+            for (const auto& mismatch : mismatches) {
+                std::cout << "  frame " << mismatch << std::endl;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        GpuAllocation memory;
+        VkDeviceSize capacity = 0;
+        bool pending = false;
+        uint64_t frameNumber = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool bgra = false;
+    };
+
+    struct Frame {
+        uint64_t number;
+        uint32_t width;
+        uint32_t height;
+        bool bgra;
+        std::vector<uint8_t> pixels;
+    };
+
+    GpuAllocator* allocator = nullptr;
+    CaptureSettings settings;
+    VkMemoryPropertyFlags readbackProperties = 0;
+    std::vector<Slot> slots;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable drained;
+    std::deque<Frame> queue;
+    bool stopping = false;
+
+    // captured and dropped belong to the main thread, the rest to the worker until finish() has joined it.
+    uint64_t captured = 0;
+    uint64_t dropped = 0;
+    uint64_t processed = 0;
+    uint64_t written = 0;
+    uint64_t compared = 0;
+    uint64_t mismatched = 0;
+    uint64_t missingGoldens = 0;
+    uint32_t maxDifference = 0;
+    double workerMs = 0.0;
+    std::vector<std::string> mismatches;
+
+    static bool rgbaFormat(VkFormat format) {
+        return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+    static bool bgraFormat(VkFormat format) {
+        return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    }
+
+    static std::string frameName(uint64_t number, const char* extension) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(number), extension);
+        return name;
+    }
+
+    void workerLoop() {
+        for (;;) {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                frame = std::move(queue.front());
+                queue.pop_front();
+            }
+            drained.notify_one();
+
+            auto start = std::chrono::steady_clock::now();
+            process(frame);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            workerMs += elapsed.count();
+            processed++;
+        }
+    }
+
+    void process(Frame& frame) {
+        if (frame.bgra) {
+            for (size_t i = 0; i < frame.pixels.size(); i += 4) {
+                std::swap(frame.pixels[i], frame.pixels[i + 2]);
+            }
+        }
+
+        if (!settings.directory.empty()) {
+            bool ok;
+            if (settings.format == CaptureFormat::Png) {
+                ok = writePng(settings.directory + "/" + frameName(frame.number, "png"), frame.width, frame.height, frame.pixels);
+            } else {
+                std::ofstream file(settings.directory + "/" + frameName(frame.number, "raw"), std::ios::binary);
+                file.write(reinterpret_cast<const char*>(frame.pixels.data()), frame.pixels.size());
+                ok = static_cast<bool>(file);
+            }
+            if (ok) {
+                written++;
+            }
+        }
+
+        if (!settings.goldenDirectory.empty()) {
+            compare(frame);
+        }
+    }
+
+    // goldens are raw captures of the same size: tightly packed rgba rows, as written with CaptureFormat::Raw.
+    void compare(const Frame& frame) {
+        compared++;
+        std::string name = frameName(frame.number, "raw");
+
+        std::ifstream file(settings.goldenDirectory + "/" + name, std::ios::binary | std::ios::ate);
+        if (!file || static_cast<size_t>(file.tellg()) != frame.pixels.size()) {
+            missingGoldens++;
+            recordMismatch(name + ": no golden frame of " + std::to_string(frame.width) + "x" + std::to_string(frame.height));
+            return;
+        }
+        std::vector<uint8_t> golden(frame.pixels.size());
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(golden.data()), golden.size());
+
+        uint64_t differingPixels = 0;
+        uint32_t frameMax = 0;
+        for (size_t i = 0; i < golden.size(); i += 4) {
+            uint32_t pixelMax = 0;
+            for (size_t c = 0; c < 4; c++) {
+                pixelMax = std::max<uint32_t>(pixelMax, std::abs(int(frame.pixels[i + c]) - int(golden[i + c])));
+            }
+            frameMax = std::max(frameMax, pixelMax);
+            if (pixelMax > settings.tolerance) {
+                differingPixels++;
+            }
+        }
+
+        maxDifference = std::max(maxDifference, frameMax);
+        if (differingPixels > 0) {
+            mismatched++;
+            recordMismatch(name + ": " + std::to_string(differingPixels) + " pixels differ, by up to " + std::to_string(frameMax));
+        }
+    }
+
+    void recordMismatch(const std::string& description) {
+        if (mismatches.size() < MAX_REPORTED_MISMATCHES) {
+            mismatches.push_back(description);
+        }
+    }
+};
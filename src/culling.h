@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+#include "descriptors.h"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// an object as the cull shader reads it (std430): where it sits, how big it is, which mesh it draws, and the material
+// handed through to its instance data.
+struct CullObject {
+    std::array<float, 2> position;
+    float scale;
+    float phase;
+    std::array<float, 3> color;
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t padding[3];
+};
+
+// a mesh as the cull shader reads it: its range of the index buffer and the radius of a circle around its vertices.
+struct CullMesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    float radius;
+};
+
+// animates and frustum-culls every object on the GPU, then draws whatever survived with a single indirect call.
+//
+// each frame the cull shader writes the instance data for its slot's slice of the caller's instance buffer plus one
+// VkDrawIndexedIndirectCommand per visible object, so the CPU cost of a frame does not grow with the object count.
+// with vkCmdDrawIndexedIndirectCount the commands are compacted and counted on the GPU; without it every object keeps
+// its command and culled objects simply draw zero instances.
+class GpuCuller {
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    // instanceBuffer must hold objectCount InstanceData entries per frame in flight and allow storage writes. the
+    // object and mesh buffers are left empty; fill them with uploadBuffer-style copies before the first cmdCull().
+    void init(VkDevice device, GpuAllocator& allocator, DescriptorCache& descriptors, VkShaderModule cullShader, VkPipelineCache pipelineCache,
+              uint32_t objectCount, uint32_t meshCount, uint32_t framesInFlight, VkBuffer instanceBuffer, bool compact) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->objectCount = objectCount;
+        this->compact = compact;
+
+        allocator.createBuffer(sizeof(CullObject) * objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectBuffer, objectMemory);
+        allocator.createBuffer(sizeof(CullMesh) * meshCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer, meshMemory);
+
+        commandSliceSize = sizeof(VkDrawIndexedIndirectCommand) * objectCount;
+        allocator.createBuffer(commandSliceSize * framesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffer, indirectMemory);
+        allocator.createBuffer(sizeof(uint32_t) * framesInFlight,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBuffer, countMemory);
+
+        createDescriptors(descriptors, instanceBuffer);
+        createPipeline(descriptors, cullShader, pipelineCache);
+    }
+
+    void cleanup() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        vkDestroyPipeline(device, pipeline, nullptr);
+
+        allocator->destroyBuffer(countBuffer, countMemory);
+        allocator->destroyBuffer(indirectBuffer, indirectMemory);
+        allocator->destroyBuffer(meshBuffer, meshMemory);
+        allocator->destroyBuffer(objectBuffer, objectMemory);
+        device = VK_NULL_HANDLE;
+    }
+
+    VkBuffer objects() const {
+        return objectBuffer;
+    }
+
+    VkBuffer meshes() const {
+        return meshBuffer;
+    }
+
+    bool compacts() const {
+        return compact;
+    }
+
+    // records the cull dispatch for a frame slot. must be outside a render pass; the caller must have waited for the
+    // previous use of the slot. afterwards the slot's instances and commands are visible to vertex input and cmdDraw().
+    // viewScale and viewOffset map world space to clip space, as in the vertex shader.
+    void cmdCull(VkCommandBuffer commandBuffer, uint32_t frame, float time, const std::array<float, 2>& viewScale,
+                 const std::array<float, 2>& viewOffset) {
+        if (compact) {
+            vkCmdFillBuffer(commandBuffer, countBuffer, sizeof(uint32_t) * frame, sizeof(uint32_t), 0);
+
+            VkBufferMemoryBarrier clearBarrier{};
+            clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            clearBarrier.buffer = countBuffer;
+            clearBarrier.offset = sizeof(uint32_t) * frame;
+            clearBarrier.size = sizeof(uint32_t);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 0, nullptr, 1, &clearBarrier, 0, nullptr);
+        }
+
+        Params params{time, objectCount, frame, compact ? 1u : 0u, viewScale, viewOffset};
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(commandBuffer, (objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+        VkMemoryBarrier cullBarrier{};
+        cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             1, &cullBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    // draws the frame slot's surviving objects. the caller binds the pipeline and both vertex buffers, with the
+    // instance buffer at the slot's slice, since firstInstance counts from the start of the slice.
+    void cmdDraw(VkCommandBuffer commandBuffer, uint32_t frame) const {
+        VkDeviceSize commandOffset = commandSliceSize * frame;
+        if (compact) {
+            vkCmdDrawIndexedIndirectCount(commandBuffer, indirectBuffer, commandOffset, countBuffer, sizeof(uint32_t) * frame,
+                                          objectCount, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, commandOffset, objectCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+private:
+    // matches the push constant block of cull.comp.
+    struct Params {
+        float time;
+        uint32_t objectCount;
+        uint32_t frame;
+        uint32_t compact;
+        std::array<float, 2> viewScale;
+        std::array<float, 2> viewOffset;
+    };
+
+    static constexpr uint32_t BINDING_COUNT = 5;
+
+    VkDevice device = VK_NULL_HANDLE;
+    GpuAllocator* allocator = nullptr;
+    uint32_t objectCount = 0;
+    bool compact = false;
+
+    VkBuffer objectBuffer = VK_NULL_HANDLE;
+    GpuAllocation objectMemory;
+    VkBuffer meshBuffer = VK_NULL_HANDLE;
+    GpuAllocation meshMemory;
+    VkBuffer indirectBuffer = VK_NULL_HANDLE;
+    GpuAllocation indirectMemory;
+    VkDeviceSize commandSliceSize = 0;
+    VkBuffer countBuffer = VK_NULL_HANDLE;
+    GpuAllocation countMemory;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    // one set for every frame: the shader offsets into each buffer by the frame index it is pushed.
+    void createDescriptors(DescriptorCache& descriptors, VkBuffer instanceBuffer) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(BINDING_COUNT);
+        for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        descriptorSetLayout = descriptors.getSetLayout(bindings);
+
+        std::vector<VkDescriptorBufferInfo> buffers;
+        for (VkBuffer buffer : {objectBuffer, meshBuffer, instanceBuffer, indirectBuffer, countBuffer}) {
+            buffers.push_back({buffer, 0, VK_WHOLE_SIZE});
+        }
+        descriptorSet = descriptors.getSet(descriptorSetLayout, buffers);
+    }
+
+    void createPipeline(DescriptorCache& descriptors, VkShaderModule cullShader, VkPipelineCache pipelineCache) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(Params);
+
+        pipelineLayout = descriptors.getPipelineLayout({descriptorSetLayout}, {pushConstantRange});
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = cullShader;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = pipelineLayout;
+
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull pipeline!");
+        }
+    }
+};
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// hands out descriptor sets from a growing list of pools and gives them all back at once with reset().
+//
+// sets are never freed one at a time, so the pools are created without FREE_DESCRIPTOR_SET and the driver can treat
+// them as plain bump allocators.
+class DescriptorAllocator {
+public:
+    static constexpr uint32_t SETS_PER_POOL = 64;
+
+    void init(VkDevice device) {
+        this->device = device;
+    }
+
+    void cleanup() {
+        for (auto pool : pools) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+        pools.clear();
+        usedPools = 0;
+    }
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout) {
+        if (usedPools == 0) {
+            nextPool();
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = pools[usedPools - 1];
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+            allocInfo.descriptorPool = nextPool();
+            result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+
+        return set;
+    }
+
+    // returns every set to the pools. pools are kept, so a steady frame never creates another one.
+    void reset() {
+        for (uint32_t i = 0; i < usedPools; i++) {
+            vkResetDescriptorPool(device, pools[i], 0);
+        }
+        usedPools = 0;
+    }
+
+    uint32_t poolCount() const {
+        return static_cast<uint32_t>(pools.size());
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> pools;
+    uint32_t usedPools = 0;
+
+    VkDescriptorPool nextPool() {
+        if (usedPools < pools.size()) {
+            return pools[usedPools++];
+        }
+
+        // sized for the sets this renderer builds; a set that does not fit simply moves on to the next pool.
+        std::vector<VkDescriptorPoolSize> poolSizes = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SETS_PER_POOL},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SETS_PER_POOL},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SETS_PER_POOL * 4},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, SETS_PER_POOL},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SETS_PER_POOL},
+        };
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = SETS_PER_POOL;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        pools.push_back(pool);
+        usedPools++;
+        return pool;
+    }
+};
+
+// owns every descriptor set layout, pipeline layout and long-lived descriptor set, each created once per distinct
+// signature and shared by everyone who asks for the same one.
+//
+// per-frame data goes through dynamic descriptors into a UniformRing, so no set's contents ever change once written.
+class DescriptorCache {
+public:
+    void init(VkDevice device) {
+        this->device = device;
+        persistent.init(device);
+    }
+
+    void cleanup() {
+        persistent.cleanup();
+        sets.clear();
+
+        for (const auto& entry : pipelineLayouts) {
+            vkDestroyPipelineLayout(device, entry.second, nullptr);
+        }
+        pipelineLayouts.clear();
+
+        for (const auto& entry : setLayouts) {
+            vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+        }
+        setLayouts.clear();
+        layoutBindings.clear();
+    }
+
+    // immutable samplers are not part of the signature and are not supported.
+    VkDescriptorSetLayout getSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+        std::sort(bindings.begin(), bindings.end(),
+                  [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+        std::string key;
+        for (const auto& binding : bindings) {
+            appendKey(key, binding.binding);
+            appendKey(key, binding.descriptorType);
+            appendKey(key, binding.descriptorCount);
+            appendKey(key, binding.stageFlags);
+        }
+
+        auto found = setLayouts.find(key);
+        if (found != setLayouts.end()) {
+            stats.layoutHits++;
+            return found->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        setLayouts[key] = layout;
+        layoutBindings[layout] = bindings;
+        return layout;
+    }
+
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& layouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+        std::string key;
+        for (auto layout : layouts) {
+            appendKey(key, layout);
+        }
+        for (const auto& range : pushConstantRanges) {
+            appendKey(key, range.stageFlags);
+            appendKey(key, range.offset);
+            appendKey(key, range.size);
+        }
+
+        auto found = pipelineLayouts.find(key);
+        if (found != pipelineLayouts.end()) {
+            stats.layoutHits++;
+            return found->second;
+        }
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+        layoutInfo.pSetLayouts = layouts.data();
+        layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        layoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+        VkPipelineLayout pipelineLayout;
+        if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        pipelineLayouts[key] = pipelineLayout;
+        return pipelineLayout;
+    }
+
+    // a long-lived set with buffers[i] at binding i of layout, which must have been made by getSetLayout(). dynamic
+    // buffers are written once with a fixed range and addressed per draw through dynamic offsets, so a set pointing at
+    // a ring never has to change.
+    VkDescriptorSet getSet(VkDescriptorSetLayout layout, const std::vector<VkDescriptorBufferInfo>& buffers) {
+        std::string key;
+        appendKey(key, layout);
+        for (const auto& buffer : buffers) {
+            appendKey(key, buffer.buffer);
+            appendKey(key, buffer.offset);
+            appendKey(key, buffer.range);
+        }
+
+        auto found = sets.find(key);
+        if (found != sets.end()) {
+            stats.setHits++;
+            return found->second;
+        }
+
+        VkDescriptorSet set = persistent.allocate(layout);
+        writeBuffers(set, layout, buffers);
+        sets[key] = set;
+        return set;
+    }
+
+    void printStats() const {
+        std::cout << "descriptors: " << setLayouts.size() << " set layouts, " << pipelineLayouts.size() << " pipeline layouts ("
+                  << stats.layoutHits << " cache hits), " << sets.size() << " cached sets (" << stats.setHits << " hits) in "
+                  << persistent.poolCount() << " pools" << std::endl;
+    }
+
+private:
+    struct Stats {
+        uint64_t layoutHits = 0;
+        uint64_t setHits = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::unordered_map<std::string, VkDescriptorSetLayout> setLayouts;
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> layoutBindings;
+    std::unordered_map<std::string, VkPipelineLayout> pipelineLayouts;
+    std::unordered_map<std::string, VkDescriptorSet> sets;
+
+    DescriptorAllocator persistent;
+    Stats stats;
+
+    template <typename T>
+    static void appendKey(std::string& key, const T& value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeBuffers(VkDescriptorSet set, VkDescriptorSetLayout layout, const std::vector<VkDescriptorBufferInfo>& buffers) {
+        const std::vector<VkDescriptorSetLayoutBinding>& bindings = layoutBindings.at(layout);
+        if (buffers.size() != bindings.size()) {
+            throw std::runtime_error("descriptor set needs one buffer per layout binding!");
+        }
+
+        std::vector<VkWriteDescriptorSet> writes(bindings.size());
+        for (size_t i = 0; i < bindings.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = set;
+            writes[i].dstBinding = bindings[i].binding;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &buffers[i];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+};
+
+// a persistently mapped buffer per frame in flight that per-frame uniform and storage data is bump-allocated from.
+//
+// everything written during a frame lands in that frame slot's buffer, which the GPU is done with by the time the slot
+// comes around again, so nothing is ever allocated, waited on or copied. the data is read through dynamic descriptors
+// written once with a fixed range, and each allocation is addressed by the dynamic offset allocate() returns.
+class UniformRing {
+public:
+    static constexpr VkDeviceSize DEFAULT_CAPACITY = 1024 * 1024;
+    // the largest range a dynamic descriptor into the ring may have. 16 KiB is the smallest maxUniformBufferRange
+    // the spec allows, and every buffer has this much slack past its capacity so a binding never reads past the end.
+    static constexpr VkDeviceSize MAX_RANGE = 16384;
+
+    // limits come from the device the allocator works on; every allocation meets both its uniform and storage offset
+    // alignments, so the same data can be bound either way.
+    void init(GpuAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t framesInFlight,
+              VkDeviceSize capacity = DEFAULT_CAPACITY) {
+        this->allocator = &allocator;
+        this->capacity = capacity;
+
+        alignment = std::max<VkDeviceSize>({limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, 16});
+
+        frames.resize(framesInFlight);
+        for (auto& frame : frames) {
+            allocator.createBuffer(capacity + MAX_RANGE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, frame.buffer, frame.allocation);
+        }
+    }
+
+    void cleanup() {
+        for (auto& frame : frames) {
+            allocator->destroyBuffer(frame.buffer, frame.allocation);
+        }
+        frames.clear();
+    }
+
+    VkBuffer buffer(uint32_t frame) const {
+        return frames[frame].buffer;
+    }
+
+    // starts filling a frame slot. the caller must have waited for the slot's previous frame.
+    void beginFrame(uint32_t frame) {
+        currentFrame = frame;
+        head = 0;
+    }
+
+    // reserves size bytes in the current frame's buffer and returns where to write them. dynamicOffset is the offset
+    // to pass to vkCmdBindDescriptorSets for a dynamic descriptor of this ring.
+    void* allocate(VkDeviceSize size, uint32_t& dynamicOffset) {
+        VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+        if (size > MAX_RANGE || offset + size > capacity) {
+            throw std::runtime_error("uniform ring overflow!");
+        }
+
+        head = offset + size;
+        peak = std::max(peak, head);
+        dynamicOffset = static_cast<uint32_t>(offset);
+        return static_cast<char*>(frames[currentFrame].allocation.mapped) + offset;
+    }
+
+    template <typename T>
+    uint32_t push(const T& value) {
+        uint32_t dynamicOffset;
+        std::memcpy(allocate(sizeof(T), dynamicOffset), &value, sizeof(T));
+        return dynamicOffset;
+    }
+
+    // makes the frame's writes visible to the device. a no-op on coherent memory.
+    void endFrame() {
+        if (head > 0) {
+            allocator->flush(frames[currentFrame].allocation, 0, head);
+        }
+    }
+
+    void printStats() const {
+        std::cout << "uniform ring: peak " << peak << " of " << capacity << " bytes per frame, " << frames.size()
+                  << " frames, " << alignment << "-byte alignment" << std::endl;
+    }
+
+private:
+    struct Frame {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+    };
+
+    GpuAllocator* allocator = nullptr;
+    VkDeviceSize capacity = 0;
+    VkDeviceSize alignment = 16;
+    std::vector<Frame> frames;
+    uint32_t currentFrame = 0;
+    VkDeviceSize head = 0;
+    VkDeviceSize peak = 0;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// everything initialization asks of a physical device, queried once.
+//
+// the property, feature, queue family and extension queries each go to the driver and fill freshly allocated vectors.
+// a snapshot is taken of every candidate device while picking one, and the chosen device's is kept and read by every
+// later step instead. it never changes afterwards, so init steps running on other threads can read it freely.
+struct DeviceCapabilities {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    // whether each queue family can present to the surface; all false without one.
+    std::vector<VkBool32> presentSupport;
+    // sorted, for hasExtension().
+    std::vector<std::string> extensions;
+
+    // the surface's formats and present modes stay fixed for its lifetime. its capabilities do not (the current extent
+    // follows the window), so those are still queried for every swap chain.
+    std::vector<VkSurfaceFormatKHR> surfaceFormats;
+    std::vector<VkPresentModeKHR> presentModes;
+
+    // the features2 chain, only queried when both the instance and the device are 1.2 or later. extension structures
+    // stay zeroed when the device lacks the extension.
+    bool vulkan12 = false;
+    VkPhysicalDeviceVulkan12Features features12{};
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+
+    bool hasExtension(const char* name) const {
+        return std::binary_search(extensions.begin(), extensions.end(), std::string(name));
+    }
+
+    // surface may be VK_NULL_HANDLE when rendering headless.
+    static DeviceCapabilities query(VkPhysicalDevice device, VkSurfaceKHR surface, uint32_t instanceApiVersion) {
+        DeviceCapabilities caps;
+        caps.physicalDevice = device;
+        vkGetPhysicalDeviceProperties(device, &caps.properties);
+        vkGetPhysicalDeviceFeatures(device, &caps.features);
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        caps.queueFamilies.resize(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, caps.queueFamilies.data());
+
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> available(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, available.data());
+        for (const auto& extension : available) {
+            caps.extensions.push_back(extension.extensionName);
+        }
+        std::sort(caps.extensions.begin(), caps.extensions.end());
+
+        caps.presentSupport.assign(queueFamilyCount, VK_FALSE);
+        if (surface != VK_NULL_HANDLE) {
+            for (uint32_t i = 0; i < queueFamilyCount; i++) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &caps.presentSupport[i]);
+            }
+
+            uint32_t formatCount = 0;
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+            caps.surfaceFormats.resize(formatCount);
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, caps.surfaceFormats.data());
+
+            uint32_t presentModeCount = 0;
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+            caps.presentModes.resize(presentModeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, caps.presentModes.data());
+        }
+
+        caps.vulkan12 = instanceApiVersion >= VK_API_VERSION_1_2 && caps.properties.apiVersion >= VK_API_VERSION_1_2;
+        if (caps.vulkan12) {
+            caps.queryFeatures2();
+        }
+        return caps;
+    }
+
+private:
+    // one call for the whole chain. an extension's structure may only be chained when the device has the extension.
+    void queryFeatures2() {
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features12;
+        void** next = &features12.pNext;
+        if (hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+            *next = &dynamicRenderingFeatures;
+            next = &dynamicRenderingFeatures.pNext;
+        }
+        if (hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+            *next = &presentIdFeatures;
+            next = &presentIdFeatures.pNext;
+        }
+        if (hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            *next = &presentWaitFeatures;
+            next = &presentWaitFeatures.pNext;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        // the snapshot is copied around, so it must not point into itself.
+        features12.pNext = nullptr;
+        dynamicRenderingFeatures.pNext = nullptr;
+        presentIdFeatures.pNext = nullptr;
+        presentWaitFeatures.pNext = nullptr;
+    }
+};
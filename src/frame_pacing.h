@@ -0,0 +1,479 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// how frames are paced against the display. each mode picks the present mode, the swap chain depth and how many
+// frames the CPU may record ahead.
+enum class PacingMode : uint32_t {
+    Default,
+    LowLatency,
+    Throughput,
+    Capped
+};
+
+struct PacingPolicy {
+    // in order of preference; FIFO is always available and is used when none of them is.
+    std::vector<VkPresentModeKHR> presentModes;
+    // swap chain images requested beyond the surface's minImageCount.
+    uint32_t extraImages;
+    uint32_t framesInFlight;
+    // with FIFO, block before sampling input until the last frame is on screen, so no frame waits in the queue.
+    bool waitForPresent;
+};
+
+inline bool parsePacingMode(const std::string& name, PacingMode& mode) {
+    if (name == "default") {
+        mode = PacingMode::Default;
+    } else if (name == "low-latency") {
+        mode = PacingMode::LowLatency;
+    } else if (name == "throughput") {
+        mode = PacingMode::Throughput;
+    } else if (name == "capped") {
+        mode = PacingMode::Capped;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* pacingModeName(PacingMode mode) {
+    static const char* names[] = {"default", "low-latency", "throughput", "capped"};
+    return names[static_cast<uint32_t>(mode)];
+}
+
+inline const char* presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo relaxed";
+        default:
+            return "other";
+    }
+}
+
+inline PacingPolicy pacingPolicy(PacingMode mode, uint32_t defaultFramesInFlight) {
+    switch (mode) {
+        // one frame in flight, so input is never more than one frame old when it is drawn. mailbox shows the newest
+        // finished frame at each vblank and needs a spare image to render into while another waits.
+        case PacingMode::LowLatency:
+            return {{VK_PRESENT_MODE_MAILBOX_KHR}, 1, 1, true};
+        // a deep FIFO queue keeps the GPU fed and never drops a frame, and everything idles between vblanks.
+        case PacingMode::Throughput:
+            return {{VK_PRESENT_MODE_FIFO_KHR}, 2, 3, false};
+        // the frame limiter sets the rate, so presenting should not block on top of it.
+        case PacingMode::Capped:
+            return {{VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}, 1, 2, false};
+        case PacingMode::Default:
+            break;
+    }
+    return {{VK_PRESENT_MODE_MAILBOX_KHR}, 1, defaultFramesInFlight, false};
+}
+
+// when the main loop draws. continuous draws back to back, as fast as the pacing mode allows. on-demand sleeps in the
+// event queue and draws only when input, animation or work still landing (pipelines, uploads, texture levels) changes
+// what is on screen. capped draws at a fixed rate and sleeps in the event queue in between.
+enum class LoopMode : uint32_t {
+    Continuous,
+    OnDemand,
+    Capped
+};
+
+const uint32_t LOOP_MODE_COUNT = 3;
+
+inline bool parseLoopMode(const std::string& name, LoopMode& mode) {
+    if (name == "continuous") {
+        mode = LoopMode::Continuous;
+    } else if (name == "on-demand") {
+        mode = LoopMode::OnDemand;
+    } else if (name == "capped") {
+        mode = LoopMode::Capped;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* loopModeName(LoopMode mode) {
+    static const char* names[] = {"continuous", "on-demand", "capped"};
+    return names[static_cast<uint32_t>(mode)];
+}
+
+// user plus kernel time of the whole process so far, summed over all its threads.
+inline std::chrono::nanoseconds processCpuTime() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return std::chrono::nanoseconds(0);
+    }
+    auto ticks = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    // FILETIME counts 100 ns ticks.
+    return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    auto duration = [](const timeval& time) {
+        return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+    };
+    return duration(usage.ru_utime) + duration(usage.ru_stime);
+#endif
+}
+
+// what each loop mode cost while it was in effect: wall and process cpu time, frames drawn, and wakeups, the passes
+// through the loop that came back from polling or waiting for events, whether or not they drew.
+class LoopStats {
+public:
+    // charges the mode in effect so far up to now and starts charging mode.
+    void enter(LoopMode mode) {
+        charge();
+        current = mode;
+        running = true;
+    }
+
+    void finish() {
+        charge();
+        running = false;
+    }
+
+    void wakeup() {
+        modes[static_cast<uint32_t>(current)].wakeups++;
+    }
+
+    void frame() {
+        modes[static_cast<uint32_t>(current)].frames++;
+    }
+
+    void printStats() const {
+        for (uint32_t i = 0; i < LOOP_MODE_COUNT; i++) {
+            const ModeStats& stats = modes[i];
+            double seconds = std::chrono::duration<double>(stats.wall).count();
+            if (seconds <= 0.0) {
+                continue;
+            }
+            double cpuMs = std::chrono::duration<double, std::milli>(stats.cpu).count();
+            std::cout << "loop " << loopModeName(static_cast<LoopMode>(i)) << ": " << stats.frames << " frames, " << stats.wakeups
+                      << " wakeups in " << seconds << " s (" << stats.wakeups / seconds << " per s), cpu " << cpuMs / 10.0 / seconds
+                      << "% of a core";
+            if (stats.frames > 0) {
+                std::cout << ", " << cpuMs / stats.frames << " cpu ms per frame";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct ModeStats {
+        uint64_t frames = 0;
+        uint64_t wakeups = 0;
+        Clock::duration wall{};
+        std::chrono::nanoseconds cpu{};
+    };
+
+    std::array<ModeStats, LOOP_MODE_COUNT> modes{};
+    LoopMode current = LoopMode::Continuous;
+    bool running = false;
+    Clock::time_point wallStart;
+    std::chrono::nanoseconds cpuStart{};
+
+    void charge() {
+        Clock::time_point now = Clock::now();
+        std::chrono::nanoseconds cpu = processCpuTime();
+        if (running) {
+            ModeStats& stats = modes[static_cast<uint32_t>(current)];
+            stats.wall += now - wallStart;
+            stats.cpu += cpu - cpuStart;
+        }
+        wallStart = now;
+        cpuStart = cpu;
+    }
+};
+
+// holds the frame loop to a fixed rate.
+//
+// sleeping costs no CPU but may wake up late by a scheduler tick, so wait() sleeps until shortly before the deadline
+// and spins for the rest. the margin follows the worst recent oversleep: wide enough to make the deadline, narrow
+// enough not to burn a core.
+class FrameLimiter {
+public:
+    void init(double framesPerSecond) {
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+        fps = framesPerSecond;
+        next = Clock::now() + period;
+    }
+
+    bool active() const {
+        return fps > 0.0;
+    }
+
+    void wait() {
+        Clock::time_point now = Clock::now();
+
+        // a frame that ran over starts the schedule afresh instead of trying to catch up with a burst.
+        if (now >= next) {
+            lateFrames++;
+            if (now - next > period) {
+                next = now;
+            }
+        } else {
+            Clock::time_point wake = next - spinMargin;
+            if (wake > now) {
+                std::this_thread::sleep_until(wake);
+                Clock::time_point woke = Clock::now();
+                sleepTime += woke - now;
+
+                Clock::duration oversleep = woke - wake;
+                spinMargin = std::clamp(std::max(oversleep + oversleep / 4, spinMargin - spinMargin / 64), MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+                now = woke;
+            }
+
+            Clock::time_point spinStart = now;
+            while (now < next) {
+                std::this_thread::yield();
+                now = Clock::now();
+            }
+            spinTime += now - spinStart;
+        }
+
+        frames++;
+        next += period;
+    }
+
+    void printStats() const {
+        if (frames == 0) {
+            return;
+        }
+        std::cout << "frame limiter: " << fps << " fps, avg sleep " << milliseconds(sleepTime) / frames << " ms, avg spin "
+                  << milliseconds(spinTime) / frames << " ms, " << lateFrames << " late frames, spin margin "
+                  << milliseconds(spinMargin) << " ms" << std::endl;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::duration MIN_SPIN_MARGIN = std::chrono::microseconds(200);
+    static constexpr Clock::duration MAX_SPIN_MARGIN = std::chrono::milliseconds(4);
+
+    double fps = 0.0;
+    Clock::duration period{};
+    Clock::time_point next;
+    Clock::duration spinMargin = std::chrono::milliseconds(1);
+
+    uint64_t frames = 0;
+    uint64_t lateFrames = 0;
+    Clock::duration sleepTime{};
+    Clock::duration spinTime{};
+
+    static double milliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+};
+
+// measures input-to-present latency with VK_KHR_present_id and VK_KHR_present_wait.
+//
+// every present carries an increasing id. the time its input was sampled is kept until vkWaitForPresentKHR reports that
+// the image has reached the display, so the figure includes the queueing that CPU and GPU timers cannot see. presents
+// that carry the first key pressed since the previous one are also timed from when glfw delivered that key, which
+// adds the time the event waited to be picked up by a frame.
+//
+// a waiter thread sits in vkWaitForPresentKHR for the oldest present and stamps it the moment the call returns. asking
+// once per frame from the render loop instead would only notice a present at the next frame, and inflate the figure
+// by up to a frame.
+class PresentLatency {
+public:
+    // how often the waiter polls the present it waits for. vkWaitForPresentKHR is only ever called with a timeout of
+    // zero, so the swap chain lock is never held for longer than the call, and this bounds the measurement's error.
+    static constexpr std::chrono::microseconds POLL_INTERVAL{250};
+
+    ~PresentLatency() {
+        finish();
+    }
+
+    void init(VkDevice device) {
+        this->device = device;
+        waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+        if (waitForPresent == nullptr) {
+            throw std::runtime_error("failed to load vkWaitForPresentKHR!");
+        }
+
+        stopping = false;
+        waiter = std::thread([this]() { waiterLoop(); });
+    }
+
+    // stops the waiter. presents it has not seen complete yet are not measured.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_one();
+        if (waiter.joinable()) {
+            waiter.join();
+        }
+    }
+
+    bool active() const {
+        return waitForPresent != nullptr;
+    }
+
+    // ids only have to increase per swap chain, so one counter serves every swap chain.
+    uint64_t nextId() {
+        return ++lastId;
+    }
+
+    // vkAcquireNextImageKHR, vkQueuePresentKHR and vkWaitForPresentKHR all need the swap chain externally synchronized,
+    // so the render thread holds this around its acquires and presents while the waiter holds it around each poll.
+    std::mutex& swapChainMutex() {
+        return swapChainLock;
+    }
+
+    // keyTime is a default-constructed time point when the frame shows no new key press.
+    void presented(VkSwapchainKHR swapChain, uint64_t id, std::chrono::steady_clock::time_point inputTime,
+                   std::chrono::steady_clock::time_point keyTime = {}) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back({swapChain, id, inputTime, keyTime});
+        }
+        queued.notify_one();
+    }
+
+    // blocks until every present handed over so far is on screen, or the timeout passes.
+    void waitForLatest(uint64_t timeoutNs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [this]() { return pending.empty() && !waiting; });
+    }
+
+    // the swap chain is being replaced; presents to the old one are no longer measured. returns once the waiter is no
+    // longer waiting on one of them.
+    void reset() {
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.clear();
+        generation++;
+        completed.wait(lock, [this]() { return !waiting; });
+    }
+
+    // the waiter has been stopped by finish().
+    void printStats() const {
+        if (latencies.empty()) {
+            return;
+        }
+        double total = 0.0;
+        for (double latency : latencies) {
+            total += latency;
+        }
+        std::cout << "input to present: " << latencies.size() << " frames, avg " << total / latencies.size() << " ms, p50 "
+                  << FrameProfiler::percentile(latencies, 0.50) << " ms, p99 " << FrameProfiler::percentile(latencies, 0.99) << " ms"
+                  << std::endl;
+
+        if (keyLatencies.empty()) {
+            return;
+        }
+        total = 0.0;
+        for (double latency : keyLatencies) {
+            total += latency;
+        }
+        std::cout << "key to present: " << keyLatencies.size() << " keys, avg " << total / keyLatencies.size() << " ms, p50 "
+                  << FrameProfiler::percentile(keyLatencies, 0.50) << " ms, p99 " << FrameProfiler::percentile(keyLatencies, 0.99)
+                  << " ms" << std::endl;
+    }
+
+private:
+    struct Present {
+        VkSwapchainKHR swapChain;
+        uint64_t id;
+        std::chrono::steady_clock::time_point inputTime;
+        std::chrono::steady_clock::time_point keyTime;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+    uint64_t lastId = 0;
+
+    std::thread waiter;
+    std::mutex swapChainLock;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable completed;
+    std::deque<Present> pending;
+    // true while the waiter is polling for pending.front().
+    bool waiting = false;
+    // bumped by reset(), so a wait that spans one does not pop a present of the new swap chain.
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // the waiter's until finish() has joined it.
+    std::vector<double> latencies;
+    std::vector<double> keyLatencies;
+
+    void waiterLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            queued.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            Present present = pending.front();
+            uint64_t waitGeneration = generation;
+            waiting = true;
+            lock.unlock();
+            VkResult result;
+            {
+                std::lock_guard<std::mutex> swapChainGuard(swapChainLock);
+                result = waitForPresent(device, present.swapChain, present.id, 0);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (result == VK_TIMEOUT) {
+                std::this_thread::sleep_for(POLL_INTERVAL);
+            }
+            lock.lock();
+            waiting = false;
+
+            // a present that failed counts as complete but is not recorded; one still queued is waited on again.
+            if (result != VK_TIMEOUT && generation == waitGeneration) {
+                if (result == VK_SUCCESS) {
+                    latencies.push_back(std::chrono::duration<double, std::milli>(now - present.inputTime).count());
+                    if (present.keyTime != std::chrono::steady_clock::time_point{}) {
+                        keyLatencies.push_back(std::chrono::duration<double, std::milli>(now - present.keyTime).count());
+                    }
+                }
+                pending.pop_front();
+            }
+            completed.notify_all();
+        }
+    }
+};
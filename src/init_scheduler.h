@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// runs initialization steps on a few threads, each as soon as the steps it depends on are done, and keeps a timeline
+// of when every step ran for the startup report.
+//
+// a step may only depend on steps added before it, so the graph can never have a cycle. steps that share something
+// that is not thread-safe (the gpu allocator, the descriptor or shader cache) must be ordered by a dependency.
+class InitScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t NONE = ~size_t(0);
+
+    // times are reported relative to when the scheduler was constructed, which should be as close to startup as possible.
+    InitScheduler() : origin(Clock::now()) {}
+
+    // returns the step's id for later steps to depend on. NONE entries in dependencies are ignored, so optional steps can
+    // be depended on unconditionally, and so are steps finished by an earlier run.
+    size_t add(const std::string& name, const std::vector<size_t>& dependencies, std::function<void()> run) {
+        Step step;
+        step.name = name;
+        step.run = std::move(run);
+        for (size_t dependency : dependencies) {
+            if (dependency == NONE || (dependency < firstUnrun && steps[dependency].done)) {
+                continue;
+            }
+            if (dependency >= steps.size()) {
+                throw std::runtime_error("failed to schedule init step " + name + ": it depends on a later step!");
+            }
+            step.pending++;
+            steps[dependency].dependents.push_back(steps.size());
+        }
+        steps.push_back(std::move(step));
+        return steps.size() - 1;
+    }
+
+    // runs every step added since the last run on up to threadCount threads, the caller's included. once a step throws,
+    // nothing new is started; the exception is rethrown when the steps already running have finished.
+    void run(uint32_t threadCount) {
+        std::vector<size_t> ready;
+        for (size_t i = firstUnrun; i < steps.size(); i++) {
+            if (steps[i].pending == 0) {
+                ready.push_back(i);
+            }
+        }
+
+        size_t remaining = steps.size() - firstUnrun;
+        size_t running = 0;
+        std::exception_ptr failure;
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        auto worker = [&](uint32_t thread) {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                changed.wait(lock, [&]() { return remaining == 0 || (failure && running == 0) || (!failure && !ready.empty()); });
+                if (remaining == 0 || failure) {
+                    return;
+                }
+
+                // the earliest added step first, which keeps the single-threaded order identical to the declared one.
+                auto next = std::min_element(ready.begin(), ready.end());
+                size_t index = *next;
+                ready.erase(next);
+                running++;
+
+                Step& step = steps[index];
+                lock.unlock();
+                step.thread = thread;
+                step.start = Clock::now();
+                std::exception_ptr error;
+                try {
+                    step.run();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                step.end = Clock::now();
+                lock.lock();
+
+                running--;
+                remaining--;
+                if (error && !failure) {
+                    failure = error;
+                }
+                for (size_t dependent : step.dependents) {
+                    if (--steps[dependent].pending == 0) {
+                        ready.push_back(dependent);
+                    }
+                }
+                step.done = true;
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < std::max(1u, threadCount); i++) {
+            threads.emplace_back(worker, i);
+        }
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        firstUnrun = steps.size();
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // records a moment after initialization, such as the first frame, on the timeline. only the first mark of a name counts.
+    void mark(const std::string& name) {
+        for (const auto& event : marks) {
+            if (event.name == name) {
+                return;
+            }
+        }
+        marks.push_back({name, Clock::now()});
+    }
+
+    // records work that ran outside the scheduler, such as creating the window.
+    void record(const std::string& name, Clock::time_point start, Clock::time_point end) {
+        Step step;
+        step.name = name;
+        step.start = start;
+        step.end = end;
+        step.done = true;
+        external.push_back(step);
+    }
+
+    void printTimeline() const {
+        std::vector<const Step*> ran;
+        for (const auto& step : external) {
+            ran.push_back(&step);
+        }
+        for (const auto& step : steps) {
+            if (step.done) {
+                ran.push_back(&step);
+            }
+        }
+        if (ran.empty()) {
+            return;
+        }
+        std::stable_sort(ran.begin(), ran.end(), [](const Step* a, const Step* b) { return a->start < b->start; });
+
+        double busyMs = 0.0;
+        Clock::time_point last = origin;
+        std::cout << "startup timeline (ms since start):" << std::endl;
+        for (const Step* step : ran) {
+            std::cout << "  " << std::left << std::setw(20) << step->name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(8) << milliseconds(step->start) << " -" << std::setw(8) << milliseconds(step->end)
+                      << "  (" << std::setw(6) << milliseconds(step->end) - milliseconds(step->start) << ")  thread "
+                      << step->thread << std::endl;
+            busyMs += milliseconds(step->end) - milliseconds(step->start);
+            last = std::max(last, step->end);
+        }
+        for (const auto& event : marks) {
+            std::cout << "  " << std::left << std::setw(20) << event.name << std::right << std::setw(8)
+                      << milliseconds(event.time) << std::endl;
+        }
+        std::cout << "  init took " << milliseconds(last) << " ms for " << busyMs << " ms of work" << std::endl;
+        std::cout << std::defaultfloat << std::setprecision(6);
+    }
+
+private:
+    struct Step {
+        std::string name;
+        std::function<void()> run;
+        size_t pending = 0;
+        std::vector<size_t> dependents;
+        bool done = false;
+        uint32_t thread = 0;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    struct Mark {
+        std::string name;
+        Clock::time_point time;
+    };
+
+    Clock::time_point origin;
+    std::vector<Step> steps;
+    size_t firstUnrun = 0;
+    std::vector<Step> external;
+    std::vector<Mark> marks;
+
+    double milliseconds(Clock::time_point time) const {
+        return std::chrono::duration<double, std::milli>(time - origin).count();
+    }
+};
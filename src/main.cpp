@@ -1,6 +1,25 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "allocator.h"
+#include "profiler.h"
+#include "staging.h"
+#include "transfer.h"
+#include "recording.h"
+#include "shader_cache.h"
+#include "pipeline_compiler.h"
+#include "descriptors.h"
+#include "bindless.h"
+#include "textures.h"
+#include "culling.h"
+#include "frame_pacing.h"
+#include "render_graph.h"
+#include "capture.h"
+#include "benchmark.h"
+#include "device_caps.h"
+#include "init_scheduler.h"
+#include "render_thread.h"
+
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
@@ -12,10 +31,26 @@
 #include <optional>
 #include <set>
 #include <fstream>
+#include <chrono>
+#include <string>
+#include <filesystem>
+#include <functional>
+#include <deque>
+#include <array>
+#include <cstddef>
+#include <iomanip>
+#include <thread>
+#include <cmath>
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
+// default number of frames the CPU may record ahead of the GPU. can be overridden at runtime with --frames-in-flight.
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+// frames per second of the capped loop mode unless --loop-rate asks for another rate.
+const double DEFAULT_LOOP_RATE = 30.0;
+
 const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -23,28 +58,377 @@ const std::vector<const char*> deviceExtensions = {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // a family for uploads that is not the graphics family, preferring one that can do nothing but transfers. unset
+    // when the device only has graphics-capable families, in which case uploads share the graphics queue.
+    std::optional<uint32_t> transferFamily;
+    // a family that can run the cull pass in the frame's own command buffer, ahead of the render pass. only ever the
+    // graphics family, and unset when that family has no compute support.
+    std::optional<uint32_t> computeFamily;
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
     }
 };
 
-struct SwapChainSupportDetails {
-    VkSurfaceCapabilitiesKHR capabilities;
-    std::vector<VkSurfaceFormatKHR> formats;
-    std::vector<VkPresentModeKHR> presentModes;
+struct AppConfig {
+    uint32_t framesInFlight = MAX_FRAMES_IN_FLIGHT;
+    std::string pipelineCachePath = "pipeline_cache.bin";
+
+    // render into offscreen images with no window, surface or swap chain, then exit after headlessFrames frames.
+    bool headless = false;
+    uint32_t headlessFrames = 1000;
+    // draw and present on a thread of their own, leaving the main thread to glfw's events, which reach the render thread
+    // through lock-free queues. windowed only.
+    bool renderThread = false;
+
+    // start with the frame profiler on (it can always be toggled with F2) and where to dump it on exit.
+    bool profile = false;
+    bool profilePipelineStatistics = false;
+    std::string profileOutput;
+
+    // record the scene's draws on this many worker threads into secondary command buffers; 0 records inline on the
+    // main thread. drawCount repeats the scene's draw so recording cost can be scaled up.
+    uint32_t recordThreads = 0;
+    uint32_t drawCount = 1;
+    // time recording alone for 1..N worker threads instead of rendering.
+    bool recordBenchmark = false;
+
+    // stream uploads on a dedicated transfer queue, tracked with a timeline semaphore, when the device supports it.
+    bool asyncUploads = true;
+
+    // pace frames and track their completion with one timeline semaphore on the graphics queue instead of fences.
+    bool timelineSync = false;
+
+    // a directory of .spv files or a packed shader archive. a relative path that does not exist from the working
+    // directory is also tried next to the executable and one level above it.
+    std::string shaderPath = "src/shaders";
+    std::string executablePath;
+
+    // threads compiling pipelines in the background; 0 uses half the hardware threads. while the scene pipeline is
+    // still compiling, draws use a cheap flat-shaded fallback, or are skipped without one.
+    uint32_t pipelineThreads = 0;
+    bool pipelineFallback = true;
+
+    // replace the single triangle with this many animated objects sharing the meshes above. objects are grouped by
+    // mesh so each group is one instanced draw, unless naiveInstancing issues one draw per object for comparison.
+    uint32_t instanceCount = 0;
+    bool naiveInstancing = false;
+    // render frames both ways and print objects per millisecond for each.
+    bool instanceBenchmark = false;
+    // cull and animate the instanced scene in a compute pass and draw it with one indirect call.
+    bool gpuCulling = false;
+    // scales the instanced scene about the center of the view; above 1 pushes objects off screen for culling.
+    float sceneZoom = 1.0f;
+    // bind every resource through one descriptor indexing set and let each instance pick its material by handle, so
+    // objects with different materials still share a draw. needs Vulkan 1.2 descriptor indexing.
+    bool bindless = false;
+    // with bindless, the DDS and KTX2 textures in this directory, one per material, streamed in mip by mip as the scene
+    // needs the detail.
+    std::string texturePath;
+    TextureStreamSettings textureStreaming;
+    // render straight into the swap chain image views with VK_KHR_dynamic_rendering when the device has it, instead of
+    // through a VkRenderPass and one VkFramebuffer per swap chain image.
+    bool dynamicRendering = true;
+
+    // trades latency against throughput and power by choosing the present mode, swap chain depth and frames in flight.
+    // fpsCap > 0 holds the loop to that rate with a sleep-then-spin limiter.
+    PacingMode pacing = PacingMode::Default;
+    double fpsCap = 0.0;
+    // when the windowed loop draws: back to back, only when something changed, or at loopRate frames per second while
+    // sleeping in between. F3 cycles through them at runtime.
+    LoopMode loopMode = LoopMode::Continuous;
+    double loopRate = DEFAULT_LOOP_RATE;
+
+    // copy every frame back to write it to disk and/or compare it with golden frames; off while both paths are empty.
+    CaptureSettings capture;
+
+    // threads running the steps of initialization that do not depend on each other; 0 picks up to four, 1 runs every
+    // step in order on the main thread.
+    uint32_t initThreads = 0;
+};
+
+// how long a low-latency frame waits for the previous present before giving up, so a hidden window cannot hang the loop.
+const uint64_t PRESENT_WAIT_TIMEOUT_NS = 100000000;
+const double DEFAULT_FPS_CAP = 60.0;
+// how often the on-demand loop redraws while nothing but pipelines, uploads or texture levels still landing changes
+// the picture; they do not wake the event queue when they finish.
+const double LOOP_SETTLE_INTERVAL_S = 1.0 / 60.0;
+
+// draws recorded per iteration of --record-benchmark unless --draws asks for more than one.
+const uint32_t RECORD_BENCHMARK_DRAWS = 100000;
+const uint32_t RECORD_BENCHMARK_ITERATIONS = 50;
+
+struct Vertex {
+    std::array<float, 2> pos;
+    std::array<float, 3> color;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(Vertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+        return attributeDescriptions;
+    }
+};
+
+// per-object data for the instanced scene, read through a second vertex binding stepped per instance.
+struct InstanceData {
+    std::array<float, 2> offset;
+    float scale;
+    std::array<float, 3> color;
+    // bindless handle of the object's material buffer.
+    uint32_t material;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 1;
+        attributeDescriptions[0].location = 2;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(InstanceData, offset);
+
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 3;
+        attributeDescriptions[1].format = VK_FORMAT_R32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(InstanceData, scale);
+
+        attributeDescriptions[2].binding = 1;
+        attributeDescriptions[2].location = 4;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(InstanceData, color);
+
+        attributeDescriptions[3].binding = 1;
+        attributeDescriptions[3].location = 5;
+        attributeDescriptions[3].format = VK_FORMAT_R32_UINT;
+        attributeDescriptions[3].offset = offsetof(InstanceData, material);
+
+        return attributeDescriptions;
+    }
+};
+
+// per-frame data of the instanced scene, read by instanced.vert and bindless.frag from the uniform ring.
+struct FrameUniforms {
+    std::array<float, 2> viewScale;
+    std::array<float, 2> viewOffset;
+    // bindless handle of this frame's texture residency table.
+    uint32_t textureTable;
+};
+
+// a range of the shared index buffer.
+struct Mesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+};
+
+const std::vector<Vertex> vertices = {
+    // triangle
+    {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+    // quad
+    {{-0.5f, -0.5f}, {1.0f, 1.0f, 0.0f}},
+    {{0.5f, -0.5f}, {0.0f, 1.0f, 1.0f}},
+    {{0.5f, 0.5f}, {1.0f, 0.0f, 1.0f}},
+    {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
 };
 
+const std::vector<uint16_t> indices = {
+    0, 1, 2,
+    0, 1, 2, 2, 3, 0
+};
+
+const std::vector<Mesh> meshes = {
+    {0, 3, 0},
+    {3, 6, 3}
+};
+
+// tints of the instanced scene's materials. in bindless mode each is its own storage buffer, picked per instance.
+const std::vector<std::array<float, 4>> materialTints = {
+    {1.0f, 1.0f, 1.0f, 1.0f},
+    {1.0f, 0.5f, 0.5f, 1.0f},
+    {0.5f, 1.0f, 0.5f, 1.0f},
+    {0.5f, 0.5f, 1.0f, 1.0f}
+};
+
+// a material as bindless.frag reads it (std430): a tint, and the texture streamer slot of its texture if it has one.
+struct MaterialData {
+    std::array<float, 4> tint;
+    uint32_t texture;
+};
+
+// frames rendered per mode by --instance-benchmark when not headless.
+const uint32_t INSTANCE_BENCHMARK_FRAMES = 300;
+const uint32_t INSTANCE_BENCHMARK_OBJECTS = 100000;
+
+// the frame benchmark suite's scenes: objects in the instanced scene, bytes uploaded per frame in the upload scene (in
+// chunks well below half the staging ring), and draws per frame in the pipeline churn scene.
+const uint32_t FRAME_BENCHMARK_OBJECTS = 10000;
+const VkDeviceSize FRAME_BENCHMARK_UPLOAD_BYTES = 4ull * 1024 * 1024;
+const VkDeviceSize FRAME_BENCHMARK_UPLOAD_CHUNK = 1024 * 1024;
+const uint32_t FRAME_BENCHMARK_CHURN_DRAWS = 256;
+
+const uint32_t MAX_INIT_THREADS = 4;
+
 class VkGlfwWindow {
 public:
+    explicit VkGlfwWindow(const AppConfig& config = AppConfig{})
+        : config(config), pacing(pacingPolicy(config.pacing, config.framesInFlight)), loopMode(config.loopMode),
+          renderThreadEnabled(config.renderThread && !config.headless) {}
+
     void run() {
-        initWindow();
+        if (!config.headless) {
+            auto windowStart = std::chrono::steady_clock::now();
+            initWindow();
+            startup.record("window", windowStart, std::chrono::steady_clock::now());
+        }
         initVulkan();
-        mainLoop();
+        if (config.recordBenchmark) {
+            runRecordBenchmark();
+        } else if (config.instanceBenchmark) {
+            runInstanceBenchmark();
+        } else {
+            mainLoop();
+        }
         cleanup();
+
+        if (captureFailed) {
+            throw std::runtime_error("captured frames differ from the golden frames!");
+        }
+    }
+
+    // renders one scene of the frame benchmark suite headless: warm-up frames, then settings.repetitions timed runs of
+    // settings.frames frames each. the device is only idled between repetitions. config must come from benchmarkConfig().
+    BenchmarkResult runFrameBenchmark(BenchmarkScene scene, const BenchmarkSettings& settings) {
+        initVulkan();
+        benchmarking = true;
+        profiler.setEnabled(true);
+
+        // nothing is timed until the scene pipeline is in use and the geometry has landed.
+        scenePipeline.get();
+        if (scene == BenchmarkScene::PipelineChurn) {
+            createChurnPipelines();
+        }
+        if (scene == BenchmarkScene::Upload) {
+            createUploadTarget();
+        }
+        while (!geometryReady() || PipelineCompiler::tryGet(scenePipeline) != graphicsPipeline) {
+            drawOffscreenFrame();
+        }
+        for (uint32_t i = 0; i < settings.warmupFrames; i++) {
+            drawFrameBenchmarkFrame(scene);
+            profiler.drain();
+        }
+
+        BenchmarkResult result;
+        result.scene = scene;
+        result.drawsPerFrame = sceneDrawCount();
+        result.deviceName = caps.properties.deviceName;
+
+        for (uint32_t repetition = 0; repetition < settings.repetitions; repetition++) {
+            // every repetition starts from an idle device with nothing left over from the one before.
+            vkDeviceWaitIdle(device);
+            for (uint32_t i = 0; i < config.framesInFlight; i++) {
+                profiler.resolveFrame(i);
+            }
+            profiler.takeHistory();
+            GpuAllocatorStats before = allocator.getStats();
+
+            BenchmarkRun run;
+            for (uint32_t i = 0; i < settings.frames; i++) {
+                auto frameStart = std::chrono::steady_clock::now();
+                drawFrameBenchmarkFrame(scene);
+                std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+                run.frameMs.push_back(frameTime.count());
+                profiler.drain();
+            }
+
+            vkDeviceWaitIdle(device);
+            for (uint32_t i = 0; i < config.framesInFlight; i++) {
+                profiler.resolveFrame(i);
+            }
+            for (const auto& sample : profiler.takeHistory()) {
+                run.cpuMs.push_back(sample.cpuFrameMs);
+                if (sample.hasGpu) {
+                    run.gpuMs.push_back(sample.gpuMs[static_cast<uint32_t>(GpuScope::Frame)]);
+                }
+            }
+
+            GpuAllocatorStats after = allocator.getStats();
+            run.allocations = after.totalAllocationCount - before.totalAllocationCount;
+            run.deviceAllocations = after.deviceAllocationCount - before.deviceAllocationCount;
+            result.runs.push_back(std::move(run));
+        }
+
+        printBenchmarkResult(result);
+        cleanup();
+        return result;
     }
 
 private:
+    AppConfig config;
+    PacingPolicy pacing;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    FrameLimiter limiter;
+    LoopMode loopMode = LoopMode::Continuous;
+    LoopStats loopStats;
+    // set by input, window damage and swap chain changes; the on-demand loop draws only while it is set or the scene
+    // animates or is still settling.
+    bool sceneDirty = true;
+    std::chrono::steady_clock::time_point nextLoopFrame;
+    // set up when the device has VK_KHR_present_id and VK_KHR_present_wait.
+    PresentLatency presentLatency;
+    // when this frame's input was sampled, for the input-to-present latency, and when glfw delivered the first key
+    // press not yet presented, for the key-to-present latency; default-constructed while there is none.
+    std::chrono::steady_clock::time_point inputTime;
+    std::chrono::steady_clock::time_point keyTime;
+    // with config.renderThread, frames run on a thread of their own and the main thread only handles glfw's events. the
+    // callbacks then queue what they see for the render thread instead of acting on it.
+    bool renderThreadEnabled = false;
+    RenderThreadLink renderLink;
+    std::thread::id mainThreadId = std::this_thread::get_id();
+    // the window as of its creation, or of the render thread's last pollInput(). read by the threads that may not ask glfw.
+    WindowState windowState;
+    FrameCapture frameCapture;
+    // initialization steps and the startup timeline, which ends with the first frame and the first to draw the scene
+    // with its own pipeline rather than the fallback.
+    InitScheduler startup;
+    bool sceneFrameMarked = false;
+    // set while the frame benchmark suite runs, which animates by frame number like a capture.
+    bool benchmarking = false;
+    // the pipeline churn scene's variants of the scene pipeline; its draws cycle through them.
+    std::vector<VkPipeline> churnPipelines;
+    // the upload scene's destination, which nothing ever reads.
+    VkBuffer uploadTarget = VK_NULL_HANDLE;
+    GpuAllocation uploadTargetMemory;
+    std::vector<uint8_t> uploadPayload;
+
     GLFWwindow* window;
 
     VkInstance instance;
@@ -52,216 +436,1729 @@ private:
     VkSurfaceKHR surface;
 
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    // taken once while picking physicalDevice.
+    DeviceCapabilities caps;
+    QueueFamilyIndices queueIndices;
+    // settled with the device, before the swap chain exists.
+    VkSurfaceFormatKHR surfaceFormat{};
     VkDevice device;
 
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-
-    VkSwapchainKHR swapChain;
+    VkQueue transferQueue;
+
+    // the instance version actually requested, which caps what device features can be used.
+    uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+    bool timelineSemaphoresEnabled = false;
+    bool multiDrawIndirectEnabled = false;
+    bool drawIndirectFirstInstanceEnabled = false;
+    bool drawIndirectCountEnabled = false;
+
+    GpuAllocator allocator;
+    StagingRing stagingRing;
+    AsyncUploader uploader;
+    bool asyncUploadsEnabled = false;
+    // timeline value of the geometry upload; nothing is drawn until the graphics queue has acquired it.
+    uint64_t geometryUploadValue = 0;
+    // upload value the frame being recorded has acquired and its submit must wait for, or 0.
+    uint64_t uploadWaitValue = 0;
+
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    // in headless mode these are device-local offscreen images owned by us rather than by a swap chain.
     std::vector<VkImage> swapChainImages;
+    std::vector<GpuAllocation> offscreenImageMemory;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
 
     std::vector<VkImageView> swapChainImageViews;
 
-    VkRenderPass renderPass;
+    // stays VK_NULL_HANDLE with dynamic rendering, as do the framebuffers.
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    bool dynamicRenderingEnabled = false;
+    // the loader only exports core entry points, so the extension's come from the device.
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    // the pipeline recordDraws binds this frame: the scene pipeline once it is ready, until then the fallback.
+    VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+
+    PipelineCompiler pipelineCompiler;
+    std::shared_future<VkPipeline> scenePipeline;
+    // what the scene pipeline was requested with, as the base for variants of it.
+    GraphicsPipelineDesc scenePipelineDesc;
+    std::shared_future<VkPipeline> fallbackPipeline;
+    uint64_t fallbackFrames = 0;
+    uint64_t skippedFrames = 0;
+    VkPipelineCache pipelineCache;
 
     std::vector<VkFramebuffer> swapChainFramebuffers;
     VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
-
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence inFlightFence;
+    std::vector<VkCommandBuffer> commandBuffers;
+
+    VkBuffer vertexBuffer;
+    GpuAllocation vertexBufferMemory;
+    VkBuffer indexBuffer;
+    GpuAllocation indexBufferMemory;
+
+    // the instanced scene. objects are sorted by mesh, so every group is a contiguous range of instances.
+    struct SceneObject {
+        uint32_t mesh;
+        uint32_t material;
+        std::array<float, 2> position;
+        float scale;
+        std::array<float, 3> color;
+        float phase;
+    };
+    struct InstanceGroup {
+        uint32_t mesh;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+    std::vector<SceneObject> sceneObjects;
+    std::vector<InstanceGroup> instanceGroups;
+    // persistently mapped, one slice of sceneObjects.size() instances per frame in flight.
+    VkBuffer instanceBuffer = VK_NULL_HANDLE;
+    GpuAllocation instanceBufferMemory;
+    VkDeviceSize instanceSliceSize = 0;
+    std::chrono::steady_clock::time_point sceneStart = std::chrono::steady_clock::now();
+    // space pauses the animation. the time spent paused is left out of sceneTime(), so it resumes where it stopped.
+    bool animationPaused = false;
+    std::chrono::steady_clock::time_point pauseStart;
+    std::chrono::steady_clock::duration pausedTime{};
+    // set once the cull pass exists; config.gpuCulling then picks between it and the cpu-driven draws each frame.
+    GpuCuller culler;
+    bool gpuCullingEnabled = false;
+
+    // set 1 of the graphics pipelines in bindless mode.
+    BindlessHeap bindlessHeap;
+    bool bindlessEnabled = false;
+    struct Material {
+        VkBuffer buffer;
+        GpuAllocation memory;
+        BindlessHandle handle;
+    };
+    std::vector<Material> materials;
+    // textures for the materials, streamed in as the objects using them grow on screen.
+    TextureStreamer textureStreamer;
+    bool textureCompressionBCEnabled = false;
+    std::vector<uint32_t> materialTextures;
+    // the largest object of the instanced scene, which decides how much texture detail the scene can show.
+    float sceneObjectScale = 0.0f;
+
+    DescriptorCache descriptorCache;
+    UniformRing uniformRing;
+    // set 0 of the graphics pipelines: the frame slot's uniform ring behind a dynamic uniform buffer descriptor.
+    VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> frameSets;
+    uint32_t frameUniformOffset = 0;
+
+    // one set of sync objects per frame in flight, indexed by currentFrame.
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<VkFence> inFlightFences;
+    // fence of the frame currently using each swap chain image, indexed by the acquired image index.
+    std::vector<VkFence> imagesInFlight;
+    uint32_t currentFrame = 0;
+
+    // with timeline sync the fences above are replaced by one counter: frame n signals n + 1 on the graphics queue when
+    // it finishes, so any past frame can be waited for by value. the binary semaphores stay for acquire and present.
+    bool timelineFrameSync = false;
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    // timeline value of the frame currently using each swap chain image, or 0.
+    std::vector<uint64_t> imageTimelineValues;
+
+    // frames are numbered in submission order. every frame below completedFrameCount is known to be finished on the GPU.
+    uint64_t frameNumber = 0;
+    uint64_t completedFrameCount = 0;
+
+    // objects that may still be referenced by frames in flight, destroyed once every frame below retireFrame is finished.
+    struct RetiredResource {
+        uint64_t retireFrame;
+        std::function<void()> destroy;
+    };
+    std::deque<RetiredResource> retiredResources;
+    // swap chains replaced by recreateSwapChain. frame fences only cover rendering, not the presents still queued on
+    // them, so they wait until an image of the current swap chain that was presented has been acquired again: the
+    // frame waiting on that acquire finishes after the present, and presents from one queue finish in order, so every
+    // present to the older chains is done by then.
+    std::vector<VkSwapchainKHR> oldSwapChains;
+    // per image of the current swap chain, whether it has been presented since the swap chain was created.
+    std::vector<bool> imagesPresented;
+
+    bool framebufferResized = false;
+
+    FrameProfiler profiler;
+    bool pipelineStatisticsEnabled = false;
+    // lets the secondaries of parallel recording run inside the primary's pipeline statistics query.
+    bool inheritedQueriesEnabled = false;
+
+    bool pipelineCacheWarm = false;
+
+    ShaderCache shaderCache;
+
+    ParallelRecorder recorder;
+
+    uint64_t frameCount = 0;
+    double totalFrameTimeMs = 0.0;
+    bool captureFailed = false;
 
     void initWindow() {
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+        glfwGetFramebufferSize(window, &windowState.width, &windowState.height);
+    }
+
+    static void keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
+        auto app = reinterpret_cast<VkGlfwWindow*>(glfwGetWindowUserPointer(window));
+        auto now = std::chrono::steady_clock::now();
+
+        if (app->renderThreadEnabled) {
+            app->renderLink.pushInput({InputEvent::Type::Key, key, action, now});
+        } else {
+            app->handleKey(key, action, now);
+        }
+    }
+
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<VkGlfwWindow*>(glfwGetWindowUserPointer(window));
+
+        if (app->renderThreadEnabled) {
+            app->renderLink.publishWindowState({width, height});
+        } else {
+            app->framebufferResized = true;
+            app->sceneDirty = true;
+        }
+    }
+
+    // the window system lost the window's contents, for instance when it was uncovered.
+    static void windowRefreshCallback(GLFWwindow* window) {
+        auto app = reinterpret_cast<VkGlfwWindow*>(glfwGetWindowUserPointer(window));
+
+        if (app->renderThreadEnabled) {
+            app->renderLink.pushInput({InputEvent::Type::Refresh, 0, 0, std::chrono::steady_clock::now()});
+        } else {
+            app->sceneDirty = true;
+        }
+    }
+
+    // on the thread that draws frames. time is when glfw delivered the key.
+    void handleKey(int key, int action, std::chrono::steady_clock::time_point time) {
+        if (action == GLFW_RELEASE) {
+            return;
+        }
+        sceneDirty = true;
+        if (action == GLFW_PRESS && keyTime == std::chrono::steady_clock::time_point{}) {
+            keyTime = time;
+        }
+
+        if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+            profiler.setEnabled(!profiler.isEnabled());
+        }
+        if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+            setLoopMode(static_cast<LoopMode>((static_cast<uint32_t>(loopMode) + 1) % LOOP_MODE_COUNT));
+        }
+        if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+            toggleAnimation();
+        }
     }
 
+    // instance, surface and device come first, in order. everything after them is a graph of steps run on
+    // config.initThreads threads, so shader loading and pipeline compilation overlap with creating the swap chain, its
+    // views and framebuffers. a dependency below is either something the step reads or an order between steps sharing
+    // the allocator, the descriptor cache or the shader cache, none of which is thread-safe.
     void initVulkan() {
-        createInstance();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffer();
-        createSyncObjects();
+        size_t instanceStep = startup.add("instance", {}, [this]() {
+            createInstance();
+            if (!config.headless) {
+                createSurface();
+            }
+        });
+        startup.add("device", {instanceStep}, [this]() {
+            pickPhysicalDevice();
+            createLogicalDevice();
+            allocator.init(device, physicalDevice);
+            chooseColorFormat();
+        });
+        // glfw wants the surface created on the main thread.
+        startup.run(1);
+
+        bool renderPassNeeded = !dynamicRenderingEnabled;
+        const size_t NONE = InitScheduler::NONE;
+
+        size_t swapChainStep = startup.add("swap chain", {}, [this]() {
+            if (config.headless) {
+                createOffscreenTargets();
+            } else {
+                createSwapChain();
+            }
+        });
+        size_t imageViewStep = startup.add("image views", {swapChainStep}, [this]() { createImageViews(); });
+        size_t renderPassStep = NONE;
+        if (renderPassNeeded) {
+            renderPassStep = startup.add("render pass", {}, [this]() { createRenderPass(); });
+            startup.add("framebuffers", {renderPassStep, imageViewStep}, [this]() { createFramebuffers(); });
+        }
+        size_t pipelineCacheStep = startup.add("pipeline cache", {}, [this]() { createPipelineCache(); });
+        size_t shaderStep = startup.add("shaders", {}, [this]() {
+            createShaderCache();
+            loadShaders();
+        });
+        // offscreen targets come out of the allocator too.
+        size_t descriptorStep = startup.add("descriptors", {config.headless ? swapChainStep : NONE}, [this]() { createDescriptors(); });
+        size_t pipelineStep = startup.add("pipelines", {renderPassStep, pipelineCacheStep, shaderStep, descriptorStep},
+                                          [this]() { createGraphicsPipeline(); });
+        size_t sceneStep = startup.add("scene uploads", {descriptorStep}, [this]() {
+            createUploader();
+            createGeometryBuffers();
+            if (config.instanceCount > 0) {
+                if (bindlessEnabled) {
+                    if (!config.texturePath.empty()) {
+                        createTextures();
+                    }
+                    createMaterials();
+                }
+                createInstancedScene();
+            }
+        });
+        size_t cullStep = NONE;
+        if (wantsGpuCulling()) {
+            cullStep = startup.add("cull pipeline", {sceneStep, pipelineStep}, [this]() { createCullPipeline(); });
+        }
+        // last of the allocator's users, for the capture buffers.
+        startup.add("frame resources", {swapChainStep, sceneStep, cullStep}, [this]() {
+            createCommandPool();
+            createCommandBuffers();
+            if (config.recordThreads > 0) {
+                createParallelRecorder();
+            }
+            createSyncObjects();
+            createProfiler();
+            if (wantsCapture()) {
+                createFrameCapture();
+            }
+        });
+
+        uint32_t threads = config.initThreads;
+        if (threads == 0) {
+            threads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_INIT_THREADS);
+        }
+        // the swap chain step may run on a worker, where glfw cannot be asked for the framebuffer size, so it goes by
+        // windowState. the window may have been resized since initWindow(), so take the size afresh here.
+        if (!config.headless) {
+            glfwGetFramebufferSize(window, &windowState.width, &windowState.height);
+        }
+        startup.run(threads);
+
+        if (config.fpsCap > 0.0) {
+            limiter.init(config.fpsCap);
+        }
+    }
+
+    // the color format is settled with the device rather than the swap chain, so the render pass and pipelines need not
+    // wait for the swap chain.
+    void chooseColorFormat() {
+        if (config.headless) {
+            swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+            return;
+        }
+        surfaceFormat = chooseSwapSurfaceFormat(caps.surfaceFormats);
+        swapChainImageFormat = surfaceFormat.format;
     }
 
     void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            drawFrame();
+        if (renderThreadEnabled) {
+            runRenderThread();
+        } else {
+            renderLoop();
         }
 
         vkDeviceWaitIdle(device);
+
+        // the device is idle, so every slot still holding a frame can be published before reporting.
+        for (uint32_t i = 0; i < config.framesInFlight; i++) {
+            profiler.resolveFrame(i);
+        }
+        if (frameCapture.active()) {
+            for (uint32_t i = 0; i < config.framesInFlight; i++) {
+                frameCapture.collect(i);
+            }
+            frameCapture.finish();
+        }
+        presentLatency.finish();
+        startup.printTimeline();
+        profiler.printSummary();
+        if (!config.profileOutput.empty()) {
+            profiler.writeReport(config.profileOutput);
+        }
+
+        pipelineCompiler.printMetrics();
+        if (fallbackFrames > 0 || skippedFrames > 0) {
+            std::cout << "while the scene pipeline compiled: " << fallbackFrames << " frames used the fallback, "
+                      << skippedFrames << " skipped their draws" << std::endl;
+        }
+
+        if (frameCount > 0) {
+            double averageMs = totalFrameTimeMs / frameCount;
+            std::cout << "frames in flight: " << config.framesInFlight
+                      << ", frames: " << frameCount
+                      << ", avg frame time: " << averageMs << " ms"
+                      << " (" << 1000.0 / averageMs << " fps)" << std::endl;
+        }
+        if (!config.headless) {
+            std::cout << "pacing: " << pacingModeName(config.pacing) << ", " << presentModeName(presentMode) << ", "
+                      << swapChainImages.size() << " swap chain images" << std::endl;
+        }
+        limiter.printStats();
+        if (!config.headless) {
+            loopStats.printStats();
+        }
+        if (renderThreadEnabled && renderLink.droppedInput() > 0) {
+            std::cout << "render thread: " << renderLink.droppedInput() << " input events dropped on a full queue" << std::endl;
+        }
+        presentLatency.printStats();
+        allocator.printStats();
+        shaderCache.printStats();
+        descriptorCache.printStats();
+        uniformRing.printStats();
+        if (bindlessEnabled) {
+            bindlessHeap.printStats();
+        }
+        if (textureStreamer.active()) {
+            textureStreamer.printStats();
+        }
+        if (frameCapture.active()) {
+            frameCapture.printStats();
+            captureFailed = frameCapture.failed();
+        }
+    }
+
+    // draws frames until the window is closed, or headless until enough are drawn. on the render thread when there is one.
+    void renderLoop() {
+        setLoopMode(loopMode);
+        while (config.headless ? frameCount < config.headlessFrames : loopRunning()) {
+            if (!config.headless && !waitForLoopFrame()) {
+                continue;
+            }
+            auto frameStart = std::chrono::steady_clock::now();
+
+            // the capped loop mode keeps its own rate, sleeping rather than spinning.
+            if (limiter.active() && loopMode != LoopMode::Capped) {
+                limiter.wait();
+            }
+            // with FIFO a finished frame waits in the queue for its vblank; starting the next one only once it is on
+            // screen keeps that wait out of the input latency.
+            if (pacing.waitForPresent && presentMode == VK_PRESENT_MODE_FIFO_KHR && presentLatency.active()) {
+                presentLatency.waitForLatest(PRESENT_WAIT_TIMEOUT_NS);
+            }
+
+            if (config.headless) {
+                drawOffscreenFrame();
+            } else {
+                pollInput();
+                inputTime = std::chrono::steady_clock::now();
+                sceneDirty = false;
+                drawFrame();
+            }
+
+            std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+            totalFrameTimeMs += frameTime.count();
+            if (frameCount == 0) {
+                startup.mark("first frame");
+            }
+            frameCount++;
+            loopStats.frame();
+
+            profiler.drain();
+        }
+        loopStats.finish();
+    }
+
+    // the main thread handles glfw's events while the render thread draws, until the window is closed or the render
+    // loop ends on an error, which is then rethrown here.
+    void runRenderThread() {
+        std::exception_ptr failure;
+        std::thread renderThread([this, &failure]() {
+            try {
+                renderLoop();
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            renderLink.finish();
+            glfwPostEmptyEvent();
+        });
+
+        while (!glfwWindowShouldClose(window) && !renderLink.isFinished()) {
+            glfwWaitEvents();
+        }
+        renderLink.requestStop();
+        renderThread.join();
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    bool loopRunning() const {
+        return renderThreadEnabled ? !renderLink.stopRequested() : !glfwWindowShouldClose(window);
+    }
+
+    // handles the input that arrived since the last call, either by letting glfw run its callbacks or, on the render
+    // thread, by draining what they queued.
+    void pollInput() {
+        if (!renderThreadEnabled) {
+            glfwPollEvents();
+            return;
+        }
+
+        InputEvent event;
+        while (renderLink.popInput(event)) {
+            if (event.type == InputEvent::Type::Key) {
+                handleKey(event.key, event.action, event.time);
+            } else {
+                sceneDirty = true;
+            }
+        }
+
+        WindowState state;
+        if (renderLink.updateWindowState(state)) {
+            if (state.width != windowState.width || state.height != windowState.height) {
+                framebufferResized = true;
+                sceneDirty = true;
+            }
+            windowState = state;
+        }
+    }
+
+    // blocks until input arrives or timeoutSeconds pass, or without a timeout when it is negative, then handles it.
+    void waitForEvents(double timeoutSeconds) {
+        if (renderThreadEnabled) {
+            renderLink.waitForInput(timeoutSeconds);
+            pollInput();
+        } else if (timeoutSeconds < 0.0) {
+            glfwWaitEvents();
+        } else {
+            glfwWaitEventsTimeout(timeoutSeconds);
+        }
+    }
+
+    // glfw may only be asked on the main thread. the render thread and init steps on other threads go by windowState.
+    void framebufferSize(int& width, int& height) {
+        if (std::this_thread::get_id() == mainThreadId) {
+            glfwGetFramebufferSize(window, &width, &height);
+        } else {
+            width = windowState.width;
+            height = windowState.height;
+        }
+    }
+
+    // waits for events as the loop mode asks. returns whether a frame should be drawn now; the loop comes straight
+    // back otherwise, so a close request is still seen.
+    bool waitForLoopFrame() {
+        switch (loopMode) {
+            case LoopMode::Continuous:
+                // the frame polls for events itself.
+                loopStats.wakeup();
+                return true;
+            case LoopMode::OnDemand:
+                if (sceneDirty || sceneAnimating()) {
+                    loopStats.wakeup();
+                    return true;
+                }
+                waitForEvents(sceneSettling() ? LOOP_SETTLE_INTERVAL_S : -1.0);
+                loopStats.wakeup();
+                return sceneDirty || sceneAnimating() || sceneSettling();
+            case LoopMode::Capped: {
+                auto now = std::chrono::steady_clock::now();
+                if (now < nextLoopFrame) {
+                    // input wakes the wait early; it is handled now and drawn at the next frame.
+                    waitForEvents(std::chrono::duration<double>(nextLoopFrame - now).count());
+                    loopStats.wakeup();
+                    return false;
+                }
+                // a frame that ran over starts the schedule afresh instead of catching up with a burst.
+                auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / config.loopRate));
+                nextLoopFrame = now - nextLoopFrame > period ? now + period : nextLoopFrame + period;
+                return true;
+            }
+        }
+        return true;
+    }
+
+    void setLoopMode(LoopMode mode) {
+        loopMode = mode;
+        loopStats.enter(mode);
+        nextLoopFrame = std::chrono::steady_clock::now();
+        sceneDirty = true;
+        if (!config.headless) {
+            std::cout << "loop mode: " << loopModeName(mode) << std::endl;
+        }
+    }
+
+    void toggleAnimation() {
+        auto now = std::chrono::steady_clock::now();
+        if (animationPaused) {
+            pausedTime += now - pauseStart;
+        } else {
+            pauseStart = now;
+        }
+        animationPaused = !animationPaused;
+    }
+
+    // the instanced scene moves with the clock; the triangle never changes on its own.
+    bool sceneAnimating() const {
+        return config.instanceCount > 0 && !animationPaused;
+    }
+
+    // the last frame did not show the finished scene yet: it used the fallback pipeline or skipped its draws, its
+    // geometry had not landed, or the texture streamer still has levels to stage or to make resident.
+    bool sceneSettling() const {
+        VkPipeline pipeline = PipelineCompiler::tryGet(scenePipeline);
+        return pipeline == VK_NULL_HANDLE || graphicsPipeline != pipeline || !geometryReady() ||
+               (textureStreamer.active() && !textureStreamer.settled());
     }
 
     void cleanup() {
+        // the waiter may still be blocked on a swap chain about to be destroyed.
+        presentLatency.finish();
+
+        // the device is idle by now, so everything still waiting for retirement can go.
+        for (auto& retired : retiredResources) {
+            retired.destroy();
+        }
+        retiredResources.clear();
+        for (auto oldSwapChain : oldSwapChains) {
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        }
+        oldSwapChains.clear();
+
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        }
+        for (auto fence : inFlightFences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        vkDestroySemaphore(device, frameTimeline, nullptr);
+
+        profiler.cleanup();
+        recorder.cleanup();
+        frameCapture.cleanup();
+
+        culler.cleanup();
+        uniformRing.cleanup();
+        if (uploadTarget != VK_NULL_HANDLE) {
+            allocator.destroyBuffer(uploadTarget, uploadTargetMemory);
+        }
+        for (auto& material : materials) {
+            allocator.destroyBuffer(material.buffer, material.memory);
+        }
+        textureStreamer.cleanup();
+        bindlessHeap.cleanup();
+        if (instanceBuffer != VK_NULL_HANDLE) {
+            allocator.destroyBuffer(instanceBuffer, instanceBufferMemory);
+        }
+        allocator.destroyBuffer(indexBuffer, indexBufferMemory);
+        allocator.destroyBuffer(vertexBuffer, vertexBufferMemory);
+        if (asyncUploadsEnabled) {
+            uploader.cleanup();
+        } else {
+            stagingRing.cleanup();
+        }
+
+        vkDestroyCommandPool(device, commandPool, nullptr);
+
         for (auto framebuffer : swapChainFramebuffers) {
             vkDestroyFramebuffer(device, framebuffer, nullptr);
         }
 
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        pipelineCompiler.cleanup();
+        savePipelineCache();
+        shaderCache.cleanup();
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        descriptorCache.cleanup();
         vkDestroyRenderPass(device, renderPass, nullptr);
 
         for (auto imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swapChain, nullptr);
+        if (config.headless) {
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                allocator.destroyImage(swapChainImages[i], offscreenImageMemory[i]);
+            }
+        } else {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
+        allocator.cleanup();
         vkDestroyDevice(device, nullptr);
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (!config.headless) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
+        if (!config.headless) {
+            glfwDestroyWindow(window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
     }
 
     void createSyncObjects() {
+        timelineFrameSync = config.timelineSync && timelineSemaphoresEnabled;
+        if (config.timelineSync && !timelineFrameSync) {
+            std::cout << "timeline semaphores are not supported, pacing frames with fences" << std::endl;
+        }
+
+        imageAvailableSemaphores.resize(config.framesInFlight);
+        renderFinishedSemaphores.resize(config.framesInFlight);
+
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+
+        if (timelineFrameSync) {
+            imageTimelineValues.resize(swapChainImages.size(), 0);
+
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            timelineInfo.pNext = &typeInfo;
+
+            if (vkCreateSemaphore(device, &timelineInfo, nullptr, &frameTimeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create frame timeline semaphore!");
+            }
+            return;
+        }
+
+        inFlightFences.resize(config.framesInFlight);
+        imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+
         VkFenceCreateInfo fenceInfo{};
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        for (size_t i = 0; i < config.framesInFlight; i++) {
+            if (vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+    }
+
+    // blocks until the frame that last used currentFrame's slot has finished, then refreshes completedFrameCount.
+    void waitForFrameSlot() {
+        if (timelineFrameSync) {
+            if (frameNumber >= config.framesInFlight) {
+                waitForTimelineValue(frameNumber - config.framesInFlight + 1);
+            }
+
+            // the counter is the number of finished frames, which may be ahead of the frame we waited for.
+            uint64_t value = 0;
+            vkGetSemaphoreCounterValue(device, frameTimeline, &value);
+            completedFrameCount = std::max(completedFrameCount, value);
+            return;
+        }
+
+        // only wait for the frame that last used this slot; the other frames keep running on the GPU.
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+        // the fence we just waited on belongs to frame (frameNumber - framesInFlight), and every frame before it was waited on the same way.
+        if (frameNumber >= config.framesInFlight) {
+            completedFrameCount = frameNumber - config.framesInFlight + 1;
+        }
+    }
+
+    // timeline sync only: blocks until every frame below value has finished on the GPU.
+    void waitForTimelineValue(uint64_t value) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &value;
+
+        if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for frame timeline semaphore!");
+        }
+    }
+
+    // the fence the frame's submit signals; timeline sync signals the frame timeline instead (see addFrameSignal).
+    VkFence frameFence() {
+        return timelineFrameSync ? VK_NULL_HANDLE : inFlightFences[currentFrame];
+    }
+
+    // adds the frame timeline signal to a frame submit. the vectors must outlive it.
+    void addFrameSignal(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo, std::vector<VkSemaphore>& signalSemaphores,
+                        std::vector<uint64_t>& signalValues) {
+        if (!timelineFrameSync) {
+            return;
+        }
+
+        signalValues.resize(signalSemaphores.size(), 0);
+        signalSemaphores.push_back(frameTimeline);
+        signalValues.push_back(frameNumber + 1);
+
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+    }
+
+    void drawFrame() {
+        waitForFrameSlot();
+        frameCapture.collect(currentFrame);
+        destroyRetiredResources();
+
+        profiler.resolveFrame(currentFrame);
+        profiler.beginFrame(currentFrame, frameNumber);
+
+        uint32_t imageIndex;
+        profiler.beginCpuScope(CpuScope::Acquire);
+        VkResult result;
+        {
+            // an acquire that blocks keeps the present waiter from polling meanwhile, which can only delay its timestamp.
+            std::lock_guard<std::mutex> swapChainGuard(presentLatency.swapChainMutex());
+            result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
+        profiler.endCpuScope(CpuScope::Acquire);
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing of this frame was drawn, so it must not leave a sample behind.
+            profiler.abandonFrame();
+            recreateSwapChain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+
+        // this image's last present has finished once this frame has, and with it every present to older swap chains.
+        if (!oldSwapChains.empty() && imagesPresented[imageIndex]) {
+            std::vector<VkSwapchainKHR> chains = std::move(oldSwapChains);
+            oldSwapChains.clear();
+            // frameNumber counts this frame only once it is submitted, so it is waited for explicitly.
+            retiredResources.push_back({frameNumber + 1, [this, chains]() {
+                for (auto oldSwapChain : chains) {
+                    vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+                }
+            }});
+        }
+
+        // the swap chain may hand out images out of order, so an older frame could still be rendering into this one.
+        if (timelineFrameSync) {
+            if (imageTimelineValues[imageIndex] > completedFrameCount) {
+                waitForTimelineValue(imageTimelineValues[imageIndex]);
+            }
+            imageTimelineValues[imageIndex] = frameNumber + 1;
+        } else {
+            if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+                vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+            }
+            imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+            vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        }
+
+        profiler.beginCpuScope(CpuScope::Record);
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        profiler.endCpuScope(CpuScope::Record);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        std::vector<VkSemaphore> waitSemaphores = {imageAvailableSemaphores[currentFrame]};
+        std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        std::vector<uint64_t> waitValues;
+        addUploadWait(submitInfo, timelineInfo, waitSemaphores, waitStages, waitValues);
+
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+        std::vector<VkSemaphore> signalSemaphores = {renderFinishedSemaphores[currentFrame]};
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+        std::vector<uint64_t> signalValues;
+        addFrameSignal(submitInfo, timelineInfo, signalSemaphores, signalValues);
+
+        profiler.beginCpuScope(CpuScope::Submit);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frameFence()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        profiler.endCpuScope(CpuScope::Submit);
+
+        frameNumber++;
+
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+
+        VkSwapchainKHR swapChains[] = {swapChain};
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+
+        presentInfo.pImageIndices = &imageIndex;
+
+        VkPresentIdKHR presentIdInfo{};
+        uint64_t presentId = 0;
+        if (presentLatency.active()) {
+            presentId = presentLatency.nextId();
+            presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentIdInfo.swapchainCount = 1;
+            presentIdInfo.pPresentIds = &presentId;
+            presentInfo.pNext = &presentIdInfo;
+        }
+
+        profiler.beginCpuScope(CpuScope::Present);
+        {
+            std::lock_guard<std::mutex> swapChainGuard(presentLatency.swapChainMutex());
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+        profiler.endCpuScope(CpuScope::Present);
+        profiler.endFrame();
+
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            if (imageIndex < imagesPresented.size()) {
+                imagesPresented[imageIndex] = true;
+            }
+            if (presentLatency.active()) {
+                presentLatency.presented(swapChain, presentId, inputTime, keyTime);
+            }
+            keyTime = {};
+        }
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            framebufferResized = false;
+            recreateSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+    }
+
+    void recreateSwapChain() {
+        // the new swap chain's images hold nothing yet.
+        sceneDirty = true;
+
+        // a minimized window has a zero-sized framebuffer, and a swap chain cannot be created for it. the old one stays
+        // when the window is closed in the meantime.
+        int width = 0, height = 0;
+        framebufferSize(width, height);
+        while (width == 0 || height == 0) {
+            if (!loopRunning()) {
+                return;
+            }
+            waitForEvents(-1.0);
+            framebufferSize(width, height);
+        }
+
+        VkSwapchainKHR oldSwapChain = swapChain;
+        std::vector<VkImageView> oldImageViews = swapChainImageViews;
+        presentLatency.reset();
+        std::vector<VkFramebuffer> oldFramebuffers = swapChainFramebuffers;
+
+        // createSwapChain hands the current swap chain to the driver as oldSwapchain, so it can reuse its resources.
+        createSwapChain();
+        createImageViews();
+        if (!dynamicRenderingEnabled) {
+            createFramebuffers();
+        }
+
+        // frames still in flight may render into the old images, so retire their views instead of waiting for the
+        // device. the swap chain itself may still have presents queued and waits longer; see oldSwapChains.
+        retireResource([this, oldImageViews, oldFramebuffers]() {
+            for (auto framebuffer : oldFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (auto imageView : oldImageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+        });
+        oldSwapChains.push_back(oldSwapChain);
+        imagesPresented.assign(swapChainImages.size(), false);
+
+        if (timelineFrameSync) {
+            imageTimelineValues.assign(swapChainImages.size(), 0);
+        } else {
+            imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+        }
+    }
+
+    void retireResource(std::function<void()> destroy) {
+        retiredResources.push_back({frameNumber, std::move(destroy)});
+    }
+
+    void destroyRetiredResources() {
+        while (!retiredResources.empty() && retiredResources.front().retireFrame <= completedFrameCount) {
+            retiredResources.front().destroy();
+            retiredResources.pop_front();
+        }
+    }
+
+    void drawOffscreenFrame() {
+        waitForFrameSlot();
+        frameCapture.collect(currentFrame);
+        if (!timelineFrameSync) {
+            vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        }
+
+        profiler.resolveFrame(currentFrame);
+        profiler.beginFrame(currentFrame, frameNumber);
+
+        // there is one offscreen target per frame in flight, so the frame fence also guards the target.
+        uint32_t imageIndex = currentFrame;
+
+        profiler.beginCpuScope(CpuScope::Record);
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        profiler.endCpuScope(CpuScope::Record);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues;
+        addUploadWait(submitInfo, timelineInfo, waitSemaphores, waitStages, waitValues);
+
+        std::vector<VkSemaphore> signalSemaphores;
+        std::vector<uint64_t> signalValues;
+        addFrameSignal(submitInfo, timelineInfo, signalSemaphores, signalValues);
+
+        profiler.beginCpuScope(CpuScope::Submit);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frameFence()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        profiler.endCpuScope(CpuScope::Submit);
+        profiler.endFrame();
+
+        frameNumber++;
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
+    }
+
+    void createProfiler() {
+        uint32_t timestampValidBits = caps.queueFamilies[queueIndices.graphicsFamily.value()].timestampValidBits;
+        if (timestampValidBits == 0) {
+            std::cout << "graphics queue does not support timestamps, profiling cpu time only" << std::endl;
+        }
+
+        profiler.init(device, config.framesInFlight, timestampValidBits, caps.properties.limits.timestampPeriod, pipelineStatisticsEnabled);
+        if (config.profile) {
+            profiler.setEnabled(true);
+        }
+    }
+
+    void createFrameCapture() {
+        if (!FrameCapture::supportsFormat(swapChainImageFormat)) {
+            throw std::runtime_error("failed to capture frames: the swap chain format is not 8-bit rgba or bgra!");
+        }
+        if (!config.capture.directory.empty()) {
+            std::filesystem::create_directories(config.capture.directory);
+        }
+        frameCapture.init(allocator, config.framesInFlight, config.capture);
+    }
+
+    void createCommandPool() {
+        const QueueFamilyIndices& queueFamilyIndices = queueIndices;
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+    }
+
+    void createUploader() {
+        const QueueFamilyIndices& queueFamilyIndices = queueIndices;
+        uint32_t graphicsFamily = queueFamilyIndices.graphicsFamily.value();
+
+        asyncUploadsEnabled = config.asyncUploads && timelineSemaphoresEnabled;
+        if (asyncUploadsEnabled) {
+            uint32_t transferFamily = queueFamilyIndices.transferFamily.value_or(graphicsFamily);
+            uploader.init(device, allocator, transferFamily, transferQueue, graphicsFamily);
+            std::cout << "uploads: " << (uploader.transfersOwnership() ? "dedicated transfer queue" : "graphics queue")
+                      << ", timeline semaphore" << std::endl;
+        } else {
+            stagingRing.init(device, allocator, graphicsFamily, graphicsQueue);
+            std::cout << "uploads: graphics queue, staging fences" << std::endl;
+        }
+    }
+
+    void createGeometryBuffers() {
+        VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
+        allocator.createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+
+        VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
+        allocator.createBuffer(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+
+        uploadSceneBuffer(vertexBuffer, vertices.data(), vertexBufferSize);
+        uploadSceneBuffer(indexBuffer, indices.data(), indexBufferSize);
+        submitSceneUploads();
+    }
+
+    // queues an upload that must land before the scene is drawn. geometryReady() covers everything submitted so far.
+    void uploadSceneBuffer(VkBuffer dst, const void* data, VkDeviceSize size) {
+        if (asyncUploadsEnabled) {
+            uploader.uploadBuffer(dst, 0, data, size);
+        } else {
+            stagingRing.uploadBuffer(dst, 0, data, size);
+        }
+    }
+
+    void submitSceneUploads() {
+        if (asyncUploadsEnabled) {
+            geometryUploadValue = uploader.submit();
+        } else {
+            // one submission for every buffer; the frames submitted after it on the same queue are ordered behind its barrier.
+            stagingRing.flush();
+        }
+    }
+
+    // one tiny storage buffer per material, each registered in the bindless heap.
+    void createMaterials() {
+        for (size_t i = 0; i < materialTints.size(); i++) {
+            MaterialData data{materialTints[i], materialTextures.empty() ? TextureStreamer::NOT_RESIDENT : materialTextures[i]};
+            Material material{};
+            allocator.createBuffer(sizeof(data), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, material.buffer, material.memory);
+            uploadSceneBuffer(material.buffer, &data, sizeof(data));
+            material.handle = bindlessHeap.addBuffer(material.buffer);
+            materials.push_back(material);
+        }
+        submitSceneUploads();
+    }
+
+    // opens every texture in config.texturePath and hands them to the materials in name order, wrapping around. only the
+    // mip tails are uploaded here; the rest streams in from the frame loop.
+    void createTextures() {
+        std::vector<std::filesystem::path> paths;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(config.texturePath, error)) {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file() && (extension == ".dds" || extension == ".ktx2")) {
+                paths.push_back(entry.path());
+            }
+        }
+        if (error) {
+            throw std::runtime_error("failed to list textures in " + config.texturePath + "!");
+        }
+        std::sort(paths.begin(), paths.end());
+
+        textureStreamer.init(device, caps, allocator, bindlessHeap, queueIndices.graphicsFamily.value(), graphicsQueue,
+                             config.framesInFlight, std::max<uint32_t>(1, static_cast<uint32_t>(paths.size())),
+                             textureCompressionBCEnabled, config.textureStreaming);
+
+        std::vector<uint32_t> slots;
+        for (const auto& path : paths) {
+            TextureSource source;
+            std::string reason;
+            if (!loadTextureSource(path.string(), source, reason)) {
+                std::cout << "textures: skipping " << path.string() << ": " << reason << std::endl;
+                continue;
+            }
+            if (!textureStreamer.supports(source)) {
+                std::cout << "textures: skipping " << path.string() << ": the device cannot sample its format or size" << std::endl;
+                continue;
+            }
+            slots.push_back(textureStreamer.add(std::move(source)));
+        }
+        textureStreamer.flush();
+
+        for (size_t i = 0; i < materialTints.size() && !slots.empty(); i++) {
+            materialTextures.push_back(slots[i % slots.size()]);
+        }
+        std::cout << "textures: " << slots.size() << " streaming from " << config.texturePath << std::endl;
+    }
+
+    // the objects' size on screen decides which mips each texture needs this frame.
+    void requestTextureDetail() {
+        VkExtent2D extent = swapChainExtent;
+        float pixels = sceneObjectScale * config.sceneZoom * 0.5f * static_cast<float>(std::max(extent.width, extent.height));
+        for (uint32_t slot : materialTextures) {
+            textureStreamer.request(slot, pixels);
+        }
+    }
+
+    uint32_t materialHandle(uint32_t material) const {
+        return materials.empty() ? 0 : materials[material].handle.index;
+    }
+
+    // lays the objects out on a grid, alternating meshes, then sorts them by mesh to form the instance groups.
+    void createInstancedScene() {
+        uint32_t count = config.instanceCount;
+        uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        float cell = 2.0f / columns;
+
+        sceneObjects.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            SceneObject& object = sceneObjects[i];
+            object.mesh = i % static_cast<uint32_t>(meshes.size());
+            object.material = (i / static_cast<uint32_t>(meshes.size())) % static_cast<uint32_t>(materialTints.size());
+            object.position = {-1.0f + cell * (i % columns + 0.5f), -1.0f + cell * (i / columns + 0.5f)};
+            object.scale = cell * 0.8f;
+            object.color = {0.5f + 0.5f * (i % 7) / 6.0f, 0.5f + 0.5f * (i % 5) / 4.0f, 0.5f + 0.5f * (i % 3) / 2.0f};
+            object.phase = static_cast<float>(i % 628) * 0.01f;
+            sceneObjectScale = std::max(sceneObjectScale, object.scale);
+        }
+
+        std::stable_sort(sceneObjects.begin(), sceneObjects.end(),
+                         [](const SceneObject& a, const SceneObject& b) { return a.mesh < b.mesh; });
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (instanceGroups.empty() || instanceGroups.back().mesh != sceneObjects[i].mesh) {
+                instanceGroups.push_back({sceneObjects[i].mesh, i, 0});
+            }
+            instanceGroups.back().instanceCount++;
+        }
+
+        // stays host visible even when culled on the GPU, so the cpu-driven paths can still be switched to.
+        instanceSliceSize = sizeof(InstanceData) * count;
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        if (wantsGpuCulling()) {
+            usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        }
+        allocator.createBuffer(instanceSliceSize * config.framesInFlight, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                               instanceBuffer, instanceBufferMemory);
+    }
+
+    // writes this frame's slice of the instance ring. the slot's previous frame has finished, so nothing reads it.
+    void updateInstances() {
+        float time = sceneTime();
+        VkDeviceSize sliceOffset = instanceSliceSize * currentFrame;
+        InstanceData* instances = reinterpret_cast<InstanceData*>(static_cast<char*>(instanceBufferMemory.mapped) + sliceOffset);
+
+        for (size_t i = 0; i < sceneObjects.size(); i++) {
+            const SceneObject& object = sceneObjects[i];
+            float wobble = object.scale * 0.1f;
+            instances[i].offset = {object.position[0] + wobble * std::sin(time + object.phase),
+                                   object.position[1] + wobble * std::cos(time + object.phase)};
+            instances[i].scale = object.scale;
+            instances[i].color = object.color;
+            instances[i].material = materialHandle(object.material);
+        }
+
+        allocator.flush(instanceBufferMemory, sliceOffset, instanceSliceSize);
+    }
+
+    bool wantsGpuCulling() const {
+        return config.instanceCount > 0 && (config.gpuCulling || config.instanceBenchmark);
+    }
+
+    bool wantsBindless() const {
+        return config.instanceCount > 0 && config.bindless;
+    }
+
+    bool wantsCapture() const {
+        return !config.capture.directory.empty() || !config.capture.goldenDirectory.empty();
+    }
+
+    bool cullingOnGpu() const {
+        return gpuCullingEnabled && config.gpuCulling;
+    }
+
+    // captured and benchmarked frames animate by frame number at 60 Hz instead of by the clock, so a frame shows the
+    // same scene on every run and can be compared with its golden frame.
+    float sceneTime() const {
+        if (frameCapture.active() || benchmarking) {
+            return static_cast<float>(frameNumber) / 60.0f;
+        }
+        auto now = animationPaused ? pauseStart : std::chrono::steady_clock::now();
+        return std::chrono::duration<float>(now - sceneStart - pausedTime).count();
+    }
+
+    // draws recordDraws splits for this frame: one per object or per instance group, or the repeated triangle. the
+    // gpu-culled scene is a single indirect draw.
+    uint32_t sceneDrawCount() const {
+        if (config.instanceCount == 0) {
+            return config.drawCount;
+        }
+        if (cullingOnGpu()) {
+            return 1;
+        }
+        return static_cast<uint32_t>(config.naiveInstancing ? sceneObjects.size() : instanceGroups.size());
+    }
+
+    bool geometryReady() const {
+        return !asyncUploadsEnabled || uploader.usableValue() >= geometryUploadValue;
+    }
+
+    // adds the wait for uploads acquired by the frame's command buffer to a frame submit. the vectors must outlive it.
+    void addUploadWait(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo, std::vector<VkSemaphore>& waitSemaphores,
+                       std::vector<VkPipelineStageFlags>& waitStages, std::vector<uint64_t>& waitValues) {
+        if (uploadWaitValue == 0) {
+            return;
+        }
+
+        // binary semaphores ignore their value, but every wait needs one once a timeline value is chained in.
+        waitValues.resize(waitSemaphores.size(), 0);
+        waitSemaphores.push_back(uploader.semaphore());
+        waitStages.push_back(AsyncUploader::ACQUIRE_STAGE);
+        waitValues.push_back(uploadWaitValue);
+
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+    }
+
+    void createCommandBuffers() {
+        commandBuffers.resize(config.framesInFlight);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+
+    void createParallelRecorder() {
+        const QueueFamilyIndices& queueFamilyIndices = queueIndices;
+        recorder.init(device, queueFamilyIndices.graphicsFamily.value(), config.framesInFlight, config.recordThreads);
+        if (inheritedQueriesEnabled) {
+            recorder.inheritPipelineStatistics(PIPELINE_STATISTICS);
+        }
+    }
+
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        bool parallel = recorder.workerCount() > 0;
+
+        // the slot's last frame has finished, so its uniform ring slice can be reused.
+        uniformRing.beginFrame(currentFrame);
+        if (bindlessEnabled) {
+            bindlessHeap.beginFrame(currentFrame);
+        }
+        if (textureStreamer.active()) {
+            textureStreamer.beginFrame(currentFrame, frameNumber, completedFrameCount);
+            requestTextureDetail();
+            textureStreamer.stream();
+        }
+        frameUniformOffset = uniformRing.push(frameUniforms());
+
+        // pick up uploads that have already landed on the transfer queue; anything still in flight waits for a later frame.
+        uploadWaitValue = 0;
+        if (asyncUploadsEnabled) {
+            uploadWaitValue = uploader.cmdAcquire(commandBuffer, uploader.completedValue());
+        }
+        graphicsPipeline = selectPipeline();
+        uint32_t drawCount = geometryReady() && graphicsPipeline != VK_NULL_HANDLE ? sceneDrawCount() : 0;
+        if (!sceneFrameMarked && drawCount > 0 && graphicsPipeline == PipelineCompiler::tryGet(scenePipeline)) {
+            startup.mark("first scene frame");
+            sceneFrameMarked = true;
+        }
+        if (config.instanceCount > 0 && !cullingOnGpu()) {
+            updateInstances();
+        }
+
+        profiler.cmdResetQueries(commandBuffer);
+        profiler.cmdBeginGpuScope(commandBuffer, GpuScope::Frame);
+
+        // the object buffer lands with the geometry, so there is nothing to cull before then.
+        profiler.cmdBeginGpuScope(commandBuffer, GpuScope::Cull);
+        if (cullingOnGpu() && drawCount > 0) {
+            FrameUniforms view = frameUniforms();
+            culler.cmdCull(commandBuffer, currentFrame, sceneTime(), view.viewScale, view.viewOffset);
+        }
+        profiler.cmdEndGpuScope(commandBuffer, GpuScope::Cull);
+
+        // the draws are in the secondaries, so the query runs in the primary around the whole pass and the secondaries
+        // inherit it. without inheritedQueries no query may be active across them, and parallel frames go uncounted.
+        bool parallelStatistics = parallel && inheritedQueriesEnabled;
+        if (parallelStatistics) {
+            profiler.cmdBeginPipelineStatistics(commandBuffer);
+        }
+        profiler.cmdBeginGpuScope(commandBuffer, GpuScope::RenderPass);
+
+        if (parallel) {
+            cmdBeginScene(commandBuffer, imageIndex, true);
+
+                VkFramebuffer framebuffer = dynamicRenderingEnabled ? VK_NULL_HANDLE : swapChainFramebuffers[imageIndex];
+                const std::vector<VkCommandBuffer>& secondaries = recordSecondaries(recorder, currentFrame, framebuffer, drawCount);
+                vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+            cmdEndScene(commandBuffer, imageIndex);
+        } else {
+            cmdBeginScene(commandBuffer, imageIndex, false);
+
+                profiler.cmdBeginPipelineStatistics(commandBuffer);
+                recordDraws(commandBuffer, 0, drawCount);
+                profiler.cmdEndPipelineStatistics(commandBuffer);
+
+            cmdEndScene(commandBuffer, imageIndex);
+        }
+
+        profiler.cmdEndGpuScope(commandBuffer, GpuScope::RenderPass);
+        if (parallelStatistics) {
+            profiler.cmdEndPipelineStatistics(commandBuffer);
+        }
+
+        if (frameCapture.active()) {
+            VkImageLayout layout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            frameCapture.cmdCapture(commandBuffer, currentFrame, frameNumber, swapChainImages[imageIndex], swapChainImageFormat,
+                                    swapChainExtent, layout);
+        }
+        profiler.cmdEndGpuScope(commandBuffer, GpuScope::Frame);
+
+        uniformRing.endFrame();
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    // starts rendering the scene into the swap chain image, cleared to black. secondaries says whether the draws come
+    // from secondary command buffers.
+    void cmdBeginScene(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool secondaries) {
+        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+        if (!dynamicRenderingEnabled) {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass;
+            renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = swapChainExtent;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearColor;
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                                 secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+            return;
+        }
+
+        // the render pass did this transition and its external dependency; the first scope matches the stage the
+        // submit waits for the acquire at, so the transition happens after the image is ours.
+        transitionSwapChainImage(commandBuffer, imageIndex, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfoKHR colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        colorAttachment.imageView = swapChainImageViews[imageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearColor;
+
+        VkRenderingInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        renderingInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = swapChainExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+
+        cmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+
+    void cmdEndScene(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        if (!dynamicRenderingEnabled) {
+            vkCmdEndRenderPass(commandBuffer);
+            return;
         }
 
+        cmdEndRendering(commandBuffer);
+
+        // the render pass's final layout and outgoing dependency. presentation is ordered by the semaphore the submit
+        // signals, so only a capture later in this command buffer has to wait.
+        VkImageLayout finalLayout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        VkPipelineStageFlags dstStage = wantsCapture() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        VkAccessFlags dstAccess = wantsCapture() ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+        transitionSwapChainImage(commandBuffer, imageIndex, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, finalLayout,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, dstStage, dstAccess);
     }
 
-    void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFence);
+    void transitionSwapChainImage(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = swapChainImages[imageIndex];
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
 
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    // records the scene's draws on the recorder's workers, inheriting either the render pass or the dynamic rendering
+    // formats. framebuffer may be VK_NULL_HANDLE.
+    const std::vector<VkCommandBuffer>& recordSecondaries(ParallelRecorder& parallelRecorder, uint32_t frame, VkFramebuffer framebuffer,
+                                                          uint32_t drawCount) {
+        auto recordFn = [this](VkCommandBuffer secondary, uint32_t first, uint32_t count) { recordDraws(secondary, first, count); };
+        if (dynamicRenderingEnabled) {
+            return parallelRecorder.record(frame, swapChainImageFormat, drawCount, recordFn);
+        }
+        return parallelRecorder.record(frame, renderPass, 0, framebuffer, drawCount, recordFn);
+    }
 
-        vkResetCommandBuffer(commandBuffer, 0);
-        recordCommandBuffer(commandBuffer, imageIndex);
+    // records draws [first, first + count) of the scene. only reads shared state, so workers may call it concurrently
+    // on their own command buffers; state is not inherited by secondaries, so every call binds everything it needs.
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameSets[currentFrame],
+                                1, &frameUniformOffset);
+        if (bindlessEnabled) {
+            VkDescriptorSet bindlessSet = bindlessHeap.descriptorSet();
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr);
+        }
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) swapChainExtent.width;
+        viewport.height = (float) swapChainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        VkBuffer vertexBuffers[] = {vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+        if (config.instanceCount == 0) {
+            const Mesh& mesh = meshes[0];
+            for (uint32_t i = 0; i < count; i++) {
+                if (!churnPipelines.empty()) {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, churnPipelines[(first + i) % churnPipelines.size()]);
+                }
+                vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, first + i);
+            }
+            return;
+        }
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        VkDeviceSize instanceOffset = instanceSliceSize * currentFrame;
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
 
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
+        if (cullingOnGpu()) {
+            culler.cmdDraw(commandBuffer, currentFrame);
+            return;
+        }
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphore};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        for (uint32_t i = first; i < first + count; i++) {
+            if (config.naiveInstancing) {
+                const Mesh& mesh = meshes[sceneObjects[i].mesh];
+                vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, i);
+            } else {
+                const InstanceGroup& group = instanceGroups[i];
+                const Mesh& mesh = meshes[group.mesh];
+                vkCmdDrawIndexed(commandBuffer, mesh.indexCount, group.instanceCount, mesh.firstIndex, mesh.vertexOffset, group.firstInstance);
+            }
+        }
+    }
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+    // renders the instanced scene grouped and then with one draw per object, and prints objects per millisecond for
+    // each. frame time here includes updating the instance ring, recording, and waiting on the GPU.
+    void runInstanceBenchmark() {
+        uint32_t frames = config.headless ? config.headlessFrames : INSTANCE_BENCHMARK_FRAMES;
+
+        // let the pipeline compile and the geometry land before anything is timed.
+        scenePipeline.get();
+        while (!geometryReady() || PipelineCompiler::tryGet(scenePipeline) != graphicsPipeline) {
+            drawBenchmarkFrame();
         }
 
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        std::cout << "instance benchmark: " << sceneObjects.size() << " objects, " << instanceGroups.size()
+                  << " groups, zoom " << config.sceneZoom << ", " << frames << " frames per mode" << std::endl;
 
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        std::vector<const char*> modes = {"grouped", "naive"};
+        if (gpuCullingEnabled) {
+            modes.push_back("gpu cull");
+        }
 
-        VkSwapchainKHR swapChains[] = {swapChain};
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = swapChains;
+        for (const char* mode : modes) {
+            config.naiveInstancing = std::string(mode) == "naive";
+            config.gpuCulling = std::string(mode) == "gpu cull";
+            vkDeviceWaitIdle(device);
 
-        presentInfo.pImageIndices = &imageIndex;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < frames; i++) {
+                drawBenchmarkFrame();
+            }
+            vkDeviceWaitIdle(device);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
 
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+            double frameMs = elapsed.count() / frames;
+            std::cout << std::setw(8) << mode << ": " << std::setw(7) << sceneDrawCount()
+                      << " draws/frame, " << std::fixed << std::setprecision(3) << frameMs << " ms/frame, "
+                      << std::setprecision(0) << sceneObjects.size() / frameMs << " objects/ms" << std::endl;
+        }
     }
 
-    void createCommandPool() {
-        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    void drawFrameBenchmarkFrame(BenchmarkScene scene) {
+        if (scene == BenchmarkScene::Upload) {
+            streamBenchmarkUpload();
+        }
+        drawOffscreenFrame();
+    }
 
-        VkCommandPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    // every combination of cull mode, front face and blending on top of the scene pipeline. waits for all of them, so
+    // the scene measures switching between pipelines rather than compiling them.
+    void createChurnPipelines() {
+        std::vector<std::shared_future<VkPipeline>> variants;
+        for (VkCullModeFlags cullMode : {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK}) {
+            for (VkFrontFace frontFace : {VK_FRONT_FACE_CLOCKWISE, VK_FRONT_FACE_COUNTER_CLOCKWISE}) {
+                for (bool blendEnable : {false, true}) {
+                    GraphicsPipelineDesc desc = scenePipelineDesc;
+                    desc.cullMode = cullMode;
+                    desc.frontFace = frontFace;
+                    desc.blendEnable = blendEnable;
+                    variants.push_back(pipelineCompiler.request("churn", desc));
+                }
+            }
+        }
+        for (auto& variant : variants) {
+            churnPipelines.push_back(variant.get());
+        }
+    }
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create command pool!");
+    void createUploadTarget() {
+        allocator.createBuffer(FRAME_BENCHMARK_UPLOAD_BYTES, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               uploadTarget, uploadTargetMemory);
+        uploadPayload.resize(FRAME_BENCHMARK_UPLOAD_CHUNK);
+        for (size_t i = 0; i < uploadPayload.size(); i++) {
+            uploadPayload[i] = static_cast<uint8_t>(i * 31);
         }
     }
 
-    void createCommandBuffer() {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = 1;
+    // pushes FRAME_BENCHMARK_UPLOAD_BYTES through the same path as the scene's uploads. the target is never read, so
+    // these never hold up drawing the way geometryUploadValue does.
+    void streamBenchmarkUpload() {
+        for (VkDeviceSize offset = 0; offset < FRAME_BENCHMARK_UPLOAD_BYTES; offset += FRAME_BENCHMARK_UPLOAD_CHUNK) {
+            if (asyncUploadsEnabled) {
+                uploader.uploadBuffer(uploadTarget, offset, uploadPayload.data(), FRAME_BENCHMARK_UPLOAD_CHUNK);
+            } else {
+                stagingRing.uploadBuffer(uploadTarget, offset, uploadPayload.data(), FRAME_BENCHMARK_UPLOAD_CHUNK);
+            }
+        }
+        if (asyncUploadsEnabled) {
+            uploader.submit();
+        } else {
+            stagingRing.flush();
+        }
+    }
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
+    void drawBenchmarkFrame() {
+        if (config.headless) {
+            drawOffscreenFrame();
+        } else {
+            glfwPollEvents();
+            drawFrame();
         }
     }
 
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // records the same draws over and over with 1, 2, 4, ... up to every hardware thread and prints how recording
+    // throughput scales. nothing is submitted, so only the CPU side of recording is measured.
+    void runRecordBenchmark() {
+        uint32_t drawCount = config.drawCount > 1 ? config.drawCount : RECORD_BENCHMARK_DRAWS;
+        uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        if (config.recordThreads > 0) {
+            maxThreads = config.recordThreads;
+        }
 
-        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin recording command buffer!");
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
         }
+        threadCounts.push_back(maxThreads);
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
+        // recording needs a real pipeline to bind, so this is the one place that waits for compilation.
+        graphicsPipeline = scenePipeline.get();
 
-        VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+        const QueueFamilyIndices& queueFamilyIndices = queueIndices;
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        std::cout << "record benchmark: " << drawCount << " draws, " << RECORD_BENCHMARK_ITERATIONS << " iterations" << std::endl;
+        std::cout << "threads    ms/frame    draws/ms    speedup" << std::endl;
 
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        double baselineMs = 0.0;
+        for (uint32_t threads : threadCounts) {
+            ParallelRecorder benchRecorder;
+            benchRecorder.init(device, queueFamilyIndices.graphicsFamily.value(), config.framesInFlight, threads);
 
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = (float) swapChainExtent.width;
-            viewport.height = (float) swapChainExtent.height;
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            // one untimed pass so every pool has grown to its steady-state size.
+            for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+                recordSecondaries(benchRecorder, frame, VK_NULL_HANDLE, drawCount);
+            }
 
-            VkRect2D scissor{};
-            scissor.offset = {0, 0};
-            scissor.extent = swapChainExtent;
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);            
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < RECORD_BENCHMARK_ITERATIONS; i++) {
+                recordSecondaries(benchRecorder, i % config.framesInFlight, VK_NULL_HANDLE, drawCount);
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
 
-            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+            benchRecorder.cleanup();
 
-        vkCmdEndRenderPass(commandBuffer);
+            double frameMs = elapsed.count() / RECORD_BENCHMARK_ITERATIONS;
+            if (threads == threadCounts.front()) {
+                baselineMs = frameMs;
+            }
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+            std::cout << std::setw(7) << threads
+                      << std::setw(12) << std::fixed << std::setprecision(3) << frameMs
+                      << std::setw(12) << std::setprecision(0) << drawCount / frameMs
+                      << std::setw(10) << std::setprecision(2) << baselineMs / frameMs << "x" << std::endl;
         }
     }
 
@@ -297,7 +2194,8 @@ private:
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // PRESENT_SRC_KHR only exists with VK_KHR_swapchain, so offscreen targets end ready to be copied out instead.
+        colorAttachment.finalLayout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -316,126 +2214,291 @@ private:
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+        // the implicit outgoing dependency ends at BOTTOM_OF_PIPE with no access, so a capture's copy after the pass
+        // needs one that makes the writes visible to it.
+        VkSubpassDependency captureDependency{};
+        captureDependency.srcSubpass = 0;
+        captureDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        captureDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        captureDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        captureDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        captureDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        std::vector<VkSubpassDependency> dependencies = {dependency};
+        if (wantsCapture()) {
+            dependencies.push_back(captureDependency);
+        }
+
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount = 1;
         renderPassInfo.pAttachments = &colorAttachment;
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
     }
 
+    // queues the scene pipeline (and its fallback) on the background compiler; nothing here waits for a pipeline.
+    void createDescriptors() {
+        descriptorCache.init(device);
+        uniformRing.init(allocator, caps.properties.limits, config.framesInFlight);
+
+        VkDescriptorSetLayoutBinding frameBinding{};
+        frameBinding.binding = 0;
+        frameBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        frameBinding.descriptorCount = 1;
+        frameBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        frameSetLayout = descriptorCache.getSetLayout({frameBinding});
+
+        // written once; every frame only moves the dynamic offset.
+        for (uint32_t i = 0; i < config.framesInFlight; i++) {
+            frameSets.push_back(descriptorCache.getSet(frameSetLayout, {{uniformRing.buffer(i), 0, sizeof(FrameUniforms)}}));
+        }
+
+        if (bindlessEnabled) {
+            bindlessHeap.init(device, physicalDevice, config.framesInFlight);
+            std::cout << "descriptors: bindless" << std::endl;
+        } else if (wantsBindless()) {
+            std::cout << "descriptors: bindless needs Vulkan 1.2 descriptor indexing, using per-draw sets" << std::endl;
+        }
+    }
+
+    FrameUniforms frameUniforms() const {
+        uint32_t textureTable = textureStreamer.active() ? textureStreamer.tableHandle(currentFrame).index : 0;
+        return {{config.sceneZoom, config.sceneZoom}, {0.0f, 0.0f}, textureTable};
+    }
+
     void createGraphicsPipeline() {
-        auto vertShaderCode = readFile("src/shaders/vert.spv");
-        auto fragShaderCode = readFile("src/shaders/frag.spv");
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkPipelineViewportStateCreateInfo viewportState{};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.scissorCount = 1;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-
-        VkPipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
-
-        std::vector<VkDynamicState> dynamicStates = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
-        };
-        VkPipelineDynamicStateCreateInfo dynamicState{};
-        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-        dynamicState.pDynamicStates = dynamicStates.data();
-
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = renderPass;
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
-        }
-
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        std::vector<VkDescriptorSetLayout> setLayouts = {frameSetLayout};
+        if (bindlessEnabled) {
+            setLayouts.push_back(bindlessHeap.setLayout());
+        }
+        pipelineLayout = descriptorCache.getPipelineLayout(setLayouts, {});
+
+        uint32_t threads = config.pipelineThreads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        }
+        pipelineCompiler.init(device, pipelineCache, threads);
+
+        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+        GraphicsPipelineDesc desc{};
+        desc.vertexShader = shaderCache.get("vert.spv");
+        desc.fragmentShader = shaderCache.get("frag.spv");
+        desc.bindings = {Vertex::getBindingDescription()};
+        desc.attributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+        if (config.instanceCount > 0) {
+            auto instanceAttributes = InstanceData::getAttributeDescriptions();
+            desc.vertexShader = shaderCache.get("instanced.spv");
+            desc.bindings.push_back(InstanceData::getBindingDescription());
+            desc.attributes.insert(desc.attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+            if (bindlessEnabled) {
+                desc.fragmentShader = shaderCache.get("bindless.spv");
+            }
+        }
+        desc.layout = pipelineLayout;
+        desc.renderPass = renderPass;
+        desc.subpass = 0;
+        desc.colorFormat = swapChainImageFormat;
+
+        // queued first so it is usually ready before the scene pipeline.
+        if (config.pipelineFallback) {
+            GraphicsPipelineDesc fallbackDesc = desc;
+            fallbackDesc.fragmentShader = shaderCache.get("fallback.spv");
+            fallbackPipeline = pipelineCompiler.request("fallback", fallbackDesc);
+        }
+        scenePipeline = pipelineCompiler.request("scene", desc);
+        scenePipelineDesc = desc;
+
+        std::cout << "graphics pipelines queued on " << threads << " threads"
+                  << " (" << (pipelineCacheWarm ? "warm" : "cold") << " cache)" << std::endl;
+    }
+
+    // picks the pipeline for this frame without ever waiting on the compiler.
+    VkPipeline selectPipeline() {
+        VkPipeline pipeline = PipelineCompiler::tryGet(scenePipeline);
+        if (pipeline != VK_NULL_HANDLE) {
+            return pipeline;
+        }
+
+        pipeline = PipelineCompiler::tryGet(fallbackPipeline);
+        if (pipeline != VK_NULL_HANDLE) {
+            fallbackFrames++;
+        } else {
+            skippedFrames++;
+        }
+        return pipeline;
+    }
+
+    // the cull pass is recorded into the frame's own command buffer, so it needs compute on the graphics queue, and it
+    // issues one indirect draw per object, so it needs multiDrawIndirect. each draw finds its instance through firstInstance,
+    // which indirect draws may only set with drawIndirectFirstInstance. compaction additionally needs drawIndirectCount.
+    void createCullPipeline() {
+        const QueueFamilyIndices& queueFamilyIndices = queueIndices;
+        const VkPhysicalDeviceProperties& properties = caps.properties;
+        uint32_t objectCount = static_cast<uint32_t>(sceneObjects.size());
+
+        const char* missing = nullptr;
+        if (!queueFamilyIndices.computeFamily.has_value()) {
+            missing = "compute on the graphics queue";
+        } else if (!multiDrawIndirectEnabled || properties.limits.maxDrawIndirectCount < objectCount) {
+            missing = "multiDrawIndirect";
+        } else if (!drawIndirectFirstInstanceEnabled) {
+            missing = "drawIndirectFirstInstance";
+        }
+        if (missing != nullptr) {
+            std::cout << "culling: cpu, the device lacks " << missing << std::endl;
+            return;
+        }
+
+        culler.init(device, allocator, descriptorCache, shaderCache.get("cull.spv"), pipelineCache, objectCount,
+                    static_cast<uint32_t>(meshes.size()), config.framesInFlight, instanceBuffer, drawIndirectCountEnabled);
+
+        std::vector<CullObject> objects(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            const SceneObject& object = sceneObjects[i];
+            objects[i] = {object.position, object.scale, object.phase, object.color, object.mesh, materialHandle(object.material), {}};
+        }
+
+        std::vector<CullMesh> cullMeshes;
+        for (const Mesh& mesh : meshes) {
+            float radius = 0.0f;
+            for (uint32_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i++) {
+                const Vertex& vertex = vertices[indices[i] + mesh.vertexOffset];
+                radius = std::max(radius, std::sqrt(vertex.pos[0] * vertex.pos[0] + vertex.pos[1] * vertex.pos[1]));
+            }
+            cullMeshes.push_back({mesh.firstIndex, mesh.indexCount, mesh.vertexOffset, radius});
+        }
+
+        uploadSceneBuffer(culler.objects(), objects.data(), sizeof(CullObject) * objects.size());
+        uploadSceneBuffer(culler.meshes(), cullMeshes.data(), sizeof(CullMesh) * cullMeshes.size());
+        submitSceneUploads();
+
+        gpuCullingEnabled = true;
+        std::cout << "culling: gpu compute, " << (culler.compacts() ? "compacted with vkCmdDrawIndexedIndirectCount" : "zero-instance draws for culled objects")
+                  << std::endl;
+    }
+
+    void createShaderCache() {
+        shaderCache.init(device, resolveShaderPath(config.shaderPath, config.executablePath));
+    }
+
+    // loads every shader module the pipelines will ask for, so reading and creating them is not left to the pipeline step.
+    void loadShaders() {
+        std::vector<std::string> names = {"vert.spv", "frag.spv"};
+        if (config.pipelineFallback) {
+            names.push_back("fallback.spv");
+        }
+        if (config.instanceCount > 0) {
+            names.push_back("instanced.spv");
+            if (bindlessEnabled) {
+                names.push_back("bindless.spv");
+            }
+        }
+        if (wantsGpuCulling()) {
+            names.push_back("cull.spv");
+        }
+        for (const auto& name : names) {
+            shaderCache.get(name);
+        }
+    }
+
+    void createPipelineCache() {
+        std::vector<char> cacheData = loadPipelineCacheData();
+        pipelineCacheWarm = !cacheData.empty();
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) == VK_SUCCESS) {
+            return;
+        }
+
+        // the driver may still reject a blob that passed our header checks, so retry with an empty cache.
+        pipelineCacheWarm = false;
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    // returns the on-disk cache blob, or an empty vector if it is missing or was written by a different device/driver.
+    std::vector<char> loadPipelineCacheData() {
+        if (!std::filesystem::exists(config.pipelineCachePath)) {
+            return {};
+        }
+
+        std::vector<char> data = readFile(config.pipelineCachePath);
+        const VkPhysicalDeviceProperties& properties = caps.properties;
+
+        // header layout is fixed by the spec: length, version, vendor id, device id, then the pipeline cache uuid.
+        const size_t headerSize = 16 + VK_UUID_SIZE;
+        if (data.size() < headerSize) {
+            std::cout << "pipeline cache is truncated, rebuilding" << std::endl;
+            return {};
+        }
+
+        uint32_t header[4];
+        std::memcpy(header, data.data(), sizeof(header));
+
+        if (header[0] < headerSize ||
+            header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            header[2] != properties.vendorID ||
+            header[3] != properties.deviceID ||
+            std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "pipeline cache was written by a different device or driver, rebuilding" << std::endl;
+            return {};
+        }
+
+        return data;
+    }
+
+    void savePipelineCache() {
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+            return;
+        }
+
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        // write to a temporary file first and rename it over the old cache so a crash never leaves a half-written blob.
+        std::string tempPath = config.pipelineCachePath + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "failed to write pipeline cache!" << std::endl;
+                return;
+            }
+            file.write(data.data(), dataSize);
+            file.close();
+            // a short write, such as on a full disk, must not replace a good cache with a truncated one.
+            if (!file.good()) {
+                std::cerr << "failed to write pipeline cache!" << std::endl;
+                std::error_code error;
+                std::filesystem::remove(tempPath, error);
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, config.pipelineCachePath, error);
+        if (error) {
+            std::cerr << "failed to replace pipeline cache: " << error.message() << std::endl;
+            std::filesystem::remove(tempPath, error);
+        }
     }
 
     void createImageViews() {
@@ -476,7 +2539,15 @@ private:
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // timeline semaphores need a 1.2 instance; a 1.0 loader has no vkEnumerateInstanceVersion and rejects anything newer.
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        uint32_t loaderVersion = VK_API_VERSION_1_0;
+        if (enumerateInstanceVersion != nullptr) {
+            enumerateInstanceVersion(&loaderVersion);
+        }
+        instanceApiVersion = std::min<uint32_t>(loaderVersion, VK_API_VERSION_1_2);
+        appInfo.apiVersion = instanceApiVersion;
 
         VkInstanceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -512,9 +2583,13 @@ private:
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+        // the chosen device's snapshot is kept; every later step reads it instead of asking the driver again.
         for (const auto& device : devices) {
-            if (isDeviceSuitable(device)) {
+            DeviceCapabilities candidate = DeviceCapabilities::query(device, config.headless ? VK_NULL_HANDLE : surface, instanceApiVersion);
+            if (isDeviceSuitable(candidate)) {
                 physicalDevice = device;
+                caps = std::move(candidate);
+                queueIndices = findQueueFamilies(caps);
                 break;
             }
         }
@@ -525,10 +2600,13 @@ private:
     }
 
     void createLogicalDevice() {
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices& indices = queueIndices;
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+        if (indices.transferFamily.has_value()) {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -540,18 +2618,132 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        const VkPhysicalDeviceFeatures& supportedFeatures = caps.features;
         VkPhysicalDeviceFeatures deviceFeatures{};
 
+        // pipeline statistics queries are optional hardware; the profiler falls back to timestamps only without them.
+        if (config.profilePipelineStatistics) {
+            pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+            deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+            if (pipelineStatisticsEnabled && config.recordThreads > 0) {
+                inheritedQueriesEnabled = supportedFeatures.inheritedQueries == VK_TRUE;
+                deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+            }
+        }
+
+        if (wantsGpuCulling()) {
+            multiDrawIndirectEnabled = supportedFeatures.multiDrawIndirect == VK_TRUE;
+            deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+            drawIndirectFirstInstanceEnabled = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+            deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        }
+
+        // BCn textures are skipped without it.
+        if (!config.texturePath.empty()) {
+            textureCompressionBCEnabled = supportedFeatures.textureCompressionBC == VK_TRUE;
+            deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        }
+
+        VkPhysicalDeviceFeatures2 deviceFeatures2{};
+        deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        bool presentWaitEnabled = false;
+
+        // 1.2 features can only be queried and enabled through the features2 chain, which a 1.0 device does not have.
+        bool vulkan12 = caps.vulkan12;
+        if (vulkan12) {
+            const VkPhysicalDeviceVulkan12Features& supported12 = caps.features12;
+
+            timelineSemaphoresEnabled = supported12.timelineSemaphore == VK_TRUE;
+            vulkan12Features.timelineSemaphore = supported12.timelineSemaphore;
+
+            if (wantsGpuCulling()) {
+                drawIndirectCountEnabled = supported12.drawIndirectCount == VK_TRUE;
+                vulkan12Features.drawIndirectCount = supported12.drawIndirectCount;
+            }
+
+            // partially bound, update-after-bind arrays of sampled images and storage buffers, indexed non-uniformly, and
+            // the frame's texture table picked from a storage buffer array by a uniform index.
+            if (wantsBindless()) {
+                bindlessEnabled = supportedFeatures.shaderStorageBufferArrayDynamicIndexing &&
+                                  supported12.runtimeDescriptorArray && supported12.descriptorBindingPartiallyBound &&
+                                  supported12.descriptorBindingUpdateUnusedWhilePending &&
+                                  supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                                  supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+                                  supported12.shaderSampledImageArrayNonUniformIndexing &&
+                                  supported12.shaderStorageBufferArrayNonUniformIndexing;
+                if (bindlessEnabled) {
+                    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+                    vulkan12Features.descriptorIndexing = supported12.descriptorIndexing;
+                    vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+                    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+                    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+                    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                    vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+                }
+            }
+
+            // the extension depends on create_renderpass2 and depth_stencil_resolve, which 1.2 has in core. its feature
+            // struct may only be chained when the extension is enabled, which it is only if the feature is supported.
+            if (config.dynamicRendering && caps.hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+                dynamicRenderingEnabled = caps.dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+                if (dynamicRenderingEnabled) {
+                    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+                    vulkan12Features.pNext = &dynamicRenderingFeatures;
+                }
+            }
+
+            // present_wait needs present_id: every present is tagged with an id that can then be waited on.
+            if (!config.headless && caps.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                caps.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+                presentWaitEnabled = caps.presentIdFeatures.presentId == VK_TRUE && caps.presentWaitFeatures.presentWait == VK_TRUE;
+                if (presentWaitEnabled) {
+                    presentIdFeatures.presentId = VK_TRUE;
+                    presentWaitFeatures.presentWait = VK_TRUE;
+                    presentIdFeatures.pNext = &presentWaitFeatures;
+                    presentWaitFeatures.pNext = vulkan12Features.pNext;
+                    vulkan12Features.pNext = &presentIdFeatures;
+                }
+            }
+        }
+
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        if (vulkan12) {
+            deviceFeatures2.features = deviceFeatures;
+            deviceFeatures2.pNext = &vulkan12Features;
+            createInfo.pNext = &deviceFeatures2;
+        } else {
+            createInfo.pEnabledFeatures = &deviceFeatures;
+        }
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // headless rendering never presents, so it does not need VK_KHR_swapchain.
+        std::vector<const char*> extensions;
+        if (!config.headless) {
+            extensions = deviceExtensions;
+        }
+        if (dynamicRenderingEnabled) {
+            extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        }
+        if (presentWaitEnabled) {
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
         createInfo.enabledLayerCount = 0;
         
 
@@ -559,20 +2751,37 @@ private:
             throw std::runtime_error("failed to create logical device!");
         }
 
+        if (dynamicRenderingEnabled) {
+            cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+            cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+            if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+                throw std::runtime_error("failed to load VK_KHR_dynamic_rendering commands!");
+            }
+        }
+        std::cout << "render path: " << (dynamicRenderingEnabled ? "dynamic rendering" : "render pass") << std::endl;
+        if (presentWaitEnabled) {
+            presentLatency.init(device);
+        }
+
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        transferQueue = graphicsQueue;
+        if (indices.transferFamily.has_value()) {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+        }
     }
 
     void createSwapChain() {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+        // the surface's current extent follows the window, so its capabilities are the one thing not taken from caps.
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
 
-        VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-        VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+        presentMode = chooseSwapPresentMode(caps.presentModes);
+        VkExtent2D extent = chooseSwapExtent(capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-            imageCount = swapChainSupport.capabilities.maxImageCount;
+        uint32_t imageCount = capabilities.minImageCount + pacing.extraImages;
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+            imageCount = capabilities.maxImageCount;
         }
 
         VkSwapchainCreateInfoKHR createInfo{};
@@ -585,8 +2794,14 @@ private:
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (wantsCapture()) {
+            if ((capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+                throw std::runtime_error("failed to create swap chain images that can be captured!");
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices& indices = queueIndices;
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
         if (indices.graphicsFamily != indices.presentFamily) {
@@ -597,12 +2812,12 @@ private:
             createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         }
 
-        createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+        createInfo.preTransform = capabilities.currentTransform;
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = swapChain;
 
         if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
@@ -612,22 +2827,31 @@ private:
         swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
 
-        swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
     }
 
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    void createOffscreenTargets() {
+        swapChainExtent = {WIDTH, HEIGHT};
 
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module!");
-        }
+        swapChainImages.resize(config.framesInFlight);
+        offscreenImageMemory.resize(config.framesInFlight);
 
-        return shaderModule;
+        for (size_t i = 0; i < swapChainImages.size(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            allocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImageMemory[i]);
+        }
     }
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
@@ -641,9 +2865,9 @@ private:
     }
 
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
+        for (VkPresentModeKHR preferred : pacing.presentModes) {
+            if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferred) != availablePresentModes.end()) {
+                return preferred;
             }
         }
 
@@ -655,7 +2879,7 @@ private:
             return capabilities.currentExtent;
         } else {
             int width, height;
-            glfwGetFramebufferSize(window, &width, &height);
+            framebufferSize(width, height);
 
             VkExtent2D actualExtent = {
                 static_cast<uint32_t>(width),
@@ -669,79 +2893,42 @@ private:
         }
     }
 
-    SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
-        SwapChainSupportDetails details;
-
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
-
-        uint32_t formatCount;
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
-
-        if (formatCount != 0) {
-            details.formats.resize(formatCount);
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
-        }
-
-        uint32_t presentModeCount;
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+    bool isDeviceSuitable(const DeviceCapabilities& candidate) {
+        QueueFamilyIndices indices = findQueueFamilies(candidate);
 
-        if (presentModeCount != 0) {
-            details.presentModes.resize(presentModeCount);
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+        if (config.headless) {
+            return indices.isComplete();
         }
 
-        return details;
-    }
-
-    bool isDeviceSuitable(VkPhysicalDevice device) {
-        QueueFamilyIndices indices = findQueueFamilies(device);
-
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
-
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
-            SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-        }
+        bool extensionsSupported = checkDeviceExtensionSupport(candidate);
+        bool swapChainAdequate = !candidate.surfaceFormats.empty() && !candidate.presentModes.empty();
 
         return indices.isComplete() && extensionsSupported && swapChainAdequate;
     }
 
-    bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
-        uint32_t extensionCount;
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-        for (const auto& extension : availableExtensions) {
-            requiredExtensions.erase(extension.extensionName);
+    bool checkDeviceExtensionSupport(const DeviceCapabilities& candidate) {
+        for (const char* extension : deviceExtensions) {
+            if (!candidate.hasExtension(extension)) {
+                return false;
+            }
         }
-
-        return requiredExtensions.empty();
+        return true;
     }
 
-    QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
+    QueueFamilyIndices findQueueFamilies(const DeviceCapabilities& candidate) {
         QueueFamilyIndices indices;
+        const std::vector<VkQueueFamilyProperties>& queueFamilies = candidate.queueFamilies;
 
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-        int i = 0;
+        uint32_t i = 0;
         for (const auto& queueFamily : queueFamilies) {
             if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
             }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-            if (presentSupport) {
+            // without a surface nothing is presented, so the graphics queue stands in for the present queue.
+            if (config.headless) {
+                indices.presentFamily = indices.graphicsFamily;
+            } else if (candidate.presentSupport[i]) {
                 indices.presentFamily = i;
             }
 
@@ -752,10 +2939,49 @@ private:
             i++;
         }
 
+        if (config.asyncUploads) {
+            indices.transferFamily = findTransferFamily(queueFamilies, indices.graphicsFamily);
+        }
+
+        if (indices.graphicsFamily.has_value() && (queueFamilies[indices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.computeFamily = indices.graphicsFamily;
+        }
+
         return indices;
     }
 
+    // a transfer-only family is usually backed by dedicated copy engines, so prefer it over a compute family that merely
+    // supports transfers as well. graphics families are skipped; uploads would contend with rendering there anyway.
+    std::optional<uint32_t> findTransferFamily(const std::vector<VkQueueFamilyProperties>& queueFamilies, std::optional<uint32_t> graphicsFamily) {
+        std::optional<uint32_t> fallback;
+
+        for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+            VkQueueFlags flags = queueFamilies[i].queueFlags;
+            if ((flags & VK_QUEUE_GRAPHICS_BIT) || queueFamilies[i].queueCount == 0 || i == graphicsFamily) {
+                continue;
+            }
+
+            // compute queues can always transfer even when they do not advertise it.
+            if (!(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                continue;
+            }
+
+            if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+                return i;
+            }
+            if (!fallback.has_value()) {
+                fallback = i;
+            }
+        }
+
+        return fallback;
+    }
+
     std::vector<const char*> getRequiredExtensions() {
+        if (config.headless) {
+            return {};
+        }
+
         uint32_t glfwExtensionCount = 0;
         const char** glfwExtensions;
         glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
@@ -765,6 +2991,23 @@ private:
         return extensions;
     }
 
+    // the shaders used to be opened relative to the working directory only, which breaks when the executable is started
+    // from its build directory.
+    static std::string resolveShaderPath(const std::string& path, const std::string& executablePath) {
+        std::filesystem::path shaderPath(path);
+        if (std::filesystem::exists(shaderPath) || shaderPath.is_absolute() || executablePath.empty()) {
+            return path;
+        }
+
+        std::filesystem::path executableDir = std::filesystem::absolute(executablePath).parent_path();
+        for (const auto& candidate : {executableDir / shaderPath, executableDir.parent_path() / shaderPath}) {
+            if (std::filesystem::exists(candidate)) {
+                return candidate.string();
+            }
+        }
+        return path;
+    }
+
     static std::vector<char> readFile(const std::string& filename) {
         std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -784,8 +3027,294 @@ private:
     }
 };
 
-int main() {
-    VkGlfwWindow app;
+// compiles a frame with the passes a fuller renderer would have, declared out of order and with a debug pass nothing
+// reads, prints what the render graph made of it and checks it: the graph's own invariants hold, the pass nothing reads
+// is the only one culled, the second read of hdr rides on the first one's barrier, the barriers are batched and aliasing
+// saves memory. false if any check fails. needs no device.
+bool reportSampleGraph() {
+    const VkExtent2D extent = {1920, 1080};
+    const VkExtent2D halfExtent = {extent.width / 2, extent.height / 2};
+
+    RenderGraph graph;
+    uint32_t depth = graph.createImage("depth", VK_FORMAT_D32_SFLOAT, extent);
+    uint32_t shadowMap = graph.createImage("shadow_map", VK_FORMAT_D32_SFLOAT, {2048, 2048});
+    uint32_t hdr = graph.createImage("hdr", VK_FORMAT_R16G16B16A16_SFLOAT, extent);
+    uint32_t bloom = graph.createImage("bloom", VK_FORMAT_R16G16B16A16_SFLOAT, halfExtent);
+    uint32_t ldr = graph.createImage("ldr", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    uint32_t overlay = graph.createImage("debug_overlay", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    uint32_t backbuffer = graph.importImage("backbuffer", VK_FORMAT_B8G8R8A8_SRGB, extent, VK_IMAGE_LAYOUT_UNDEFINED,
+                                            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    uint32_t post = graph.addPass("post", GraphPassType::Graphics);
+    graph.use(post, ldr, GraphAccess::SampledRead);
+    graph.use(post, backbuffer, GraphAccess::ColorAttachmentWrite);
+
+    uint32_t scene = graph.addPass("scene", GraphPassType::Graphics);
+    graph.use(scene, depth, GraphAccess::DepthAttachmentRead);
+    graph.use(scene, shadowMap, GraphAccess::SampledRead);
+    graph.use(scene, hdr, GraphAccess::ColorAttachmentWrite);
+
+    uint32_t depthPrepass = graph.addPass("depth_prepass", GraphPassType::Graphics);
+    graph.use(depthPrepass, depth, GraphAccess::DepthAttachmentWrite);
+
+    uint32_t shadow = graph.addPass("shadow", GraphPassType::Graphics);
+    graph.use(shadow, shadowMap, GraphAccess::DepthAttachmentWrite);
+
+    uint32_t debug = graph.addPass("debug_overlay", GraphPassType::Graphics);
+    graph.use(debug, depth, GraphAccess::SampledRead);
+    graph.use(debug, overlay, GraphAccess::ColorAttachmentWrite);
+
+    uint32_t bloomPass = graph.addPass("bloom", GraphPassType::Compute);
+    graph.use(bloomPass, hdr, GraphAccess::SampledRead);
+    graph.use(bloomPass, bloom, GraphAccess::StorageWrite);
+
+    uint32_t tonemap = graph.addPass("tonemap", GraphPassType::Graphics);
+    graph.use(tonemap, hdr, GraphAccess::SampledRead);
+    graph.use(tonemap, bloom, GraphAccess::SampledRead);
+    graph.use(tonemap, ldr, GraphAccess::ColorAttachmentWrite);
+
+    graph.compile();
+    graph.printReport(std::cout);
+
+    const GraphStats& stats = graph.statistics();
+    bool matches = true;
+    for (const auto& violation : graph.checkInvariants()) {
+        std::cerr << "render graph: " << violation << std::endl;
+        matches = false;
+    }
+    auto expect = [&matches](bool condition, const char* what) {
+        if (!condition) {
+            std::cerr << "render graph: " << what << std::endl;
+            matches = false;
+        }
+    };
+    expect(graph.culledPasses() == std::vector<std::string>{"debug_overlay"}, "culled something other than the unread debug overlay");
+    expect(stats.coveredReads > 0 && stats.imageBarriers < stats.accessCount + stats.finalTransitions,
+           "gave every access a barrier of its own");
+    expect(stats.barrierCalls < stats.imageBarriers, "did not batch the barriers");
+    expect(stats.aliasedBytes < stats.unaliasedBytes, "aliased no memory");
+    return matches;
+}
+
+// the configuration a benchmark scene renders with: the command line's device and sync options, headless, with the
+// scene's content on top.
+AppConfig benchmarkConfig(BenchmarkScene scene, AppConfig config) {
+    config.headless = true;
+    config.recordBenchmark = false;
+    config.instanceBenchmark = false;
+    config.capture = CaptureSettings{};
+    config.instanceCount = 0;
+    config.drawCount = 1;
+
+    switch (scene) {
+        case BenchmarkScene::Instances:
+            config.instanceCount = FRAME_BENCHMARK_OBJECTS;
+            break;
+        case BenchmarkScene::PipelineChurn:
+            config.drawCount = FRAME_BENCHMARK_CHURN_DRAWS;
+            break;
+        case BenchmarkScene::Triangle:
+        case BenchmarkScene::Upload:
+        case BenchmarkScene::Count:
+            break;
+    }
+    return config;
+}
+
+// runs every requested scene on a fresh device, so no scene inherits another's caches or allocations, then writes
+// the json report.
+int runFrameBenchmarks(const AppConfig& config, const BenchmarkSettings& settings) {
+    std::vector<BenchmarkResult> results;
+    try {
+        for (BenchmarkScene scene : settings.scenes) {
+            VkGlfwWindow app(benchmarkConfig(scene, config));
+            results.push_back(app.runFrameBenchmark(scene, settings));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!writeBenchmarkReport(settings.outputPath, settings, results)) {
+        std::cerr << "failed to write benchmark report to " << settings.outputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "benchmark report written to " << settings.outputPath << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    AppConfig config;
+    config.executablePath = argv[0];
+    std::string packShadersPath;
+    bool graphReport = false;
+    bool framesInFlightGiven = false;
+
+    // the VulkanBench target is this program with the whole benchmark suite as its default.
+    BenchmarkSettings benchmark;
+#ifdef FRAME_BENCHMARK_TARGET
+    parseBenchmarkScenes("all", benchmark.scenes);
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--frames-in-flight" && i + 1 < argc) {
+            config.framesInFlight = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+            framesInFlightGiven = true;
+        } else if (arg == "--pipeline-cache" && i + 1 < argc) {
+            config.pipelineCachePath = argv[++i];
+        } else if (arg == "--profile") {
+            config.profile = true;
+        } else if (arg == "--profile-stats") {
+            config.profilePipelineStatistics = true;
+        } else if (arg == "--profile-output" && i + 1 < argc) {
+            config.profile = true;
+            config.profileOutput = argv[++i];
+        } else if (arg == "--record-threads" && i + 1 < argc) {
+            config.recordThreads = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--init-threads" && i + 1 < argc) {
+            config.initThreads = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--draws" && i + 1 < argc) {
+            config.drawCount = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--record-benchmark") {
+            config.recordBenchmark = true;
+        } else if (arg == "--frame-benchmark" && i + 1 < argc) {
+            if (!parseBenchmarkScenes(argv[++i], benchmark.scenes)) {
+                std::cerr << "unknown benchmark scene in: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--benchmark-frames" && i + 1 < argc) {
+            benchmark.frames = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--benchmark-warmup" && i + 1 < argc) {
+            benchmark.warmupFrames = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--benchmark-repetitions" && i + 1 < argc) {
+            benchmark.repetitions = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--benchmark-output" && i + 1 < argc) {
+            benchmark.outputPath = argv[++i];
+        } else if (arg == "--no-async-uploads") {
+            config.asyncUploads = false;
+        } else if (arg == "--timeline-sync") {
+            config.timelineSync = true;
+        } else if (arg == "--pipeline-threads" && i + 1 < argc) {
+            config.pipelineThreads = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--no-pipeline-fallback") {
+            config.pipelineFallback = false;
+        } else if (arg == "--instances" && i + 1 < argc) {
+            config.instanceCount = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--bindless") {
+            config.bindless = true;
+        } else if (arg == "--textures" && i + 1 < argc) {
+            config.texturePath = argv[++i];
+        } else if (arg == "--texture-budget" && i + 1 < argc) {
+            config.textureStreaming.frameBudget = VkDeviceSize(std::max(1, std::atoi(argv[++i]))) * 1024;
+        } else if (arg == "--texture-staging" && i + 1 < argc) {
+            config.textureStreaming.stagingCapacity = VkDeviceSize(std::max(1, std::atoi(argv[++i]))) * 1024 * 1024;
+        } else if (arg == "--no-dynamic-rendering") {
+            config.dynamicRendering = false;
+        } else if (arg == "--pacing" && i + 1 < argc) {
+            if (!parsePacingMode(argv[++i], config.pacing)) {
+                std::cerr << "unknown pacing mode: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--fps-cap" && i + 1 < argc) {
+            config.fpsCap = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--render-thread") {
+            config.renderThread = true;
+        } else if (arg == "--loop" && i + 1 < argc) {
+            if (!parseLoopMode(argv[++i], config.loopMode)) {
+                std::cerr << "unknown loop mode: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--loop-rate" && i + 1 < argc) {
+            config.loopRate = std::max(0.1, std::atof(argv[++i]));
+        } else if (arg == "--capture" && i + 1 < argc) {
+            config.capture.directory = argv[++i];
+        } else if (arg == "--capture-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format == "png") {
+                config.capture.format = CaptureFormat::Png;
+            } else if (format == "raw") {
+                config.capture.format = CaptureFormat::Raw;
+            } else {
+                std::cerr << "unknown capture format: " << format << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--capture-golden" && i + 1 < argc) {
+            config.capture.goldenDirectory = argv[++i];
+        } else if (arg == "--capture-tolerance" && i + 1 < argc) {
+            config.capture.tolerance = static_cast<uint32_t>(std::clamp(std::atoi(argv[++i]), 0, 255));
+        } else if (arg == "--gpu-culling") {
+            config.gpuCulling = true;
+        } else if (arg == "--zoom" && i + 1 < argc) {
+            config.sceneZoom = std::max(0.01f, static_cast<float>(std::atof(argv[++i])));
+        } else if (arg == "--naive-instancing") {
+            config.naiveInstancing = true;
+        } else if (arg == "--instance-benchmark") {
+            config.instanceBenchmark = true;
+        } else if (arg == "--shaders" && i + 1 < argc) {
+            config.shaderPath = argv[++i];
+        } else if (arg == "--pack-shaders" && i + 1 < argc) {
+            packShadersPath = argv[++i];
+        } else if (arg == "--graph-report") {
+            graphReport = true;
+        } else if (arg == "--headless" && i + 1 < argc) {
+            config.headless = true;
+            config.headlessFrames = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::cerr << "unknown argument: " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // a cap implies capped pacing, and capped pacing without a cap holds 60 fps.
+    if (config.fpsCap > 0.0 && config.pacing == PacingMode::Default) {
+        config.pacing = PacingMode::Capped;
+    }
+    if (config.pacing == PacingMode::Capped && config.fpsCap == 0.0) {
+        config.fpsCap = DEFAULT_FPS_CAP;
+    }
+    if (!framesInFlightGiven) {
+        config.framesInFlight = pacingPolicy(config.pacing, config.framesInFlight).framesInFlight;
+    }
+
+    if (config.instanceBenchmark && config.instanceCount == 0) {
+        config.instanceCount = INSTANCE_BENCHMARK_OBJECTS;
+    }
+    // the recording benchmark times its own draw counts against the single triangle.
+    if (config.recordBenchmark) {
+        config.instanceCount = 0;
+    }
+
+    // packing needs no device, so it runs before anything vulkan is touched.
+    if (!packShadersPath.empty()) {
+        try {
+            size_t count = ShaderArchive::pack(config.shaderPath, packShadersPath);
+            std::cout << "packed " << count << " shaders into " << packShadersPath << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (graphReport) {
+        try {
+            if (!reportSampleGraph()) {
+                return EXIT_FAILURE;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (!benchmark.scenes.empty()) {
+        return runFrameBenchmarks(config, benchmark);
+    }
+
+    VkGlfwWindow app(config);
 
     try {
         app.run();
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// everything that varies between the graphics pipelines of this renderer. viewport and scissor are always dynamic.
+struct GraphicsPipelineDesc {
+    VkShaderModule vertexShader = VK_NULL_HANDLE;
+    VkShaderModule fragmentShader = VK_NULL_HANDLE;
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool blendEnable = false;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    // without a render pass the pipeline is built for dynamic rendering into a single color attachment of this format.
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+
+    bool operator==(const GraphicsPipelineDesc& other) const {
+        return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+               bindings.size() == other.bindings.size() && attributes.size() == other.attributes.size() &&
+               std::memcmp(bindings.data(), other.bindings.data(), bindings.size() * sizeof(bindings[0])) == 0 &&
+               std::memcmp(attributes.data(), other.attributes.data(), attributes.size() * sizeof(attributes[0])) == 0 &&
+               topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode &&
+               frontFace == other.frontFace && blendEnable == other.blendEnable && layout == other.layout &&
+               renderPass == other.renderPass && subpass == other.subpass && colorFormat == other.colorFormat;
+    }
+
+    struct Hash {
+        size_t operator()(const GraphicsPipelineDesc& desc) const {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            auto mix = [&hash](const void* data, size_t size) {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; i++) {
+                    hash ^= bytes[i];
+                    hash *= 0x100000001b3ull;
+                }
+            };
+
+            mix(&desc.vertexShader, sizeof(desc.vertexShader));
+            mix(&desc.fragmentShader, sizeof(desc.fragmentShader));
+            mix(desc.bindings.data(), desc.bindings.size() * sizeof(desc.bindings[0]));
+            mix(desc.attributes.data(), desc.attributes.size() * sizeof(desc.attributes[0]));
+            mix(&desc.topology, sizeof(desc.topology));
+            mix(&desc.polygonMode, sizeof(desc.polygonMode));
+            mix(&desc.cullMode, sizeof(desc.cullMode));
+            mix(&desc.frontFace, sizeof(desc.frontFace));
+            mix(&desc.blendEnable, sizeof(desc.blendEnable));
+            mix(&desc.layout, sizeof(desc.layout));
+            mix(&desc.renderPass, sizeof(desc.renderPass));
+            mix(&desc.subpass, sizeof(desc.subpass));
+            mix(&desc.colorFormat, sizeof(desc.colorFormat));
+            return static_cast<size_t>(hash);
+        }
+    };
+};
+
+// compiles graphics pipelines on a pool of worker threads into one shared VkPipelineCache.
+//
+// request() never blocks: it hands back a future that becomes ready once the pipeline exists, and asking again for a
+// description that is already queued or built returns the same future. the compiler owns every pipeline it creates.
+class PipelineCompiler {
+public:
+    struct Metrics {
+        std::string name;
+        // time spent waiting for a worker, and inside vkCreateGraphicsPipelines.
+        double queuedMs = 0.0;
+        double compileMs = 0.0;
+        // requests for this description, including the first one.
+        uint32_t requests = 0;
+        bool done = false;
+    };
+
+    void init(VkDevice device, VkPipelineCache pipelineCache, uint32_t threadCount) {
+        this->device = device;
+        this->pipelineCache = pipelineCache;
+        stopping = false;
+
+        threadCount = std::max(1u, threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~PipelineCompiler() {
+        stopThreads();
+    }
+
+    // finishes whatever is still queued, then destroys every pipeline.
+    void cleanup() {
+        stopThreads();
+
+        for (auto& entry : entries) {
+            if (entry.second.pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(device, entry.second.pipeline, nullptr);
+            }
+        }
+        entries.clear();
+    }
+
+    std::shared_future<VkPipeline> request(const std::string& name, const GraphicsPipelineDesc& desc) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto existing = entries.find(desc);
+        if (existing != entries.end()) {
+            metrics[existing->second.metricsIndex].requests++;
+            return existing->second.future;
+        }
+
+        Entry& entry = entries[desc];
+        entry.metricsIndex = metrics.size();
+        entry.future = entry.promise.get_future().share();
+
+        Metrics metric;
+        metric.name = name;
+        metric.requests = 1;
+        metrics.push_back(metric);
+
+        // the key lives in the map, whose nodes never move, so the job can keep pointing at it.
+        const GraphicsPipelineDesc* key = &entries.find(desc)->first;
+        auto queuedAt = std::chrono::steady_clock::now();
+        queue.push_back([this, key, queuedAt] { compile(*key, queuedAt); });
+        wake.notify_one();
+
+        return entry.future;
+    }
+
+    // the pipeline if it has finished compiling, otherwise VK_NULL_HANDLE. rethrows if compilation failed.
+    static VkPipeline tryGet(const std::shared_future<VkPipeline>& future) {
+        if (!future.valid() || future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return VK_NULL_HANDLE;
+        }
+        return future.get();
+    }
+
+    void printMetrics() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::cout << "pipelines: " << metrics.size() << " compiled on " << threads.size() << " threads" << std::endl;
+        for (const auto& metric : metrics) {
+            std::cout << "  " << std::left << std::setw(12) << metric.name << std::right << std::fixed << std::setprecision(2)
+                      << " queued " << std::setw(8) << metric.queuedMs << " ms, compiled " << std::setw(8) << metric.compileMs
+                      << " ms, " << metric.requests << (metric.requests == 1 ? " request" : " requests")
+                      << (metric.done ? "" : " (unfinished)") << std::endl;
+        }
+    }
+
+private:
+    struct Entry {
+        std::promise<VkPipeline> promise;
+        std::shared_future<VkPipeline> future;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        size_t metricsIndex = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> queue;
+    bool stopping = false;
+
+    std::unordered_map<GraphicsPipelineDesc, Entry, GraphicsPipelineDesc::Hash> entries;
+    std::vector<Metrics> metrics;
+
+    void stopThreads() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+
+    void compile(const GraphicsPipelineDesc& desc, std::chrono::steady_clock::time_point queuedAt) {
+        auto compileStart = std::chrono::steady_clock::now();
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkResult result = createPipeline(desc, pipeline);
+
+        auto compileEnd = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries.find(desc)->second;
+        Metrics& metric = metrics[entry.metricsIndex];
+        metric.queuedMs = std::chrono::duration<double, std::milli>(compileStart - queuedAt).count();
+        metric.compileMs = std::chrono::duration<double, std::milli>(compileEnd - compileStart).count();
+        metric.done = true;
+
+        if (result != VK_SUCCESS) {
+            entry.promise.set_exception(std::make_exception_ptr(std::runtime_error("failed to create graphics pipeline " + metric.name + "!")));
+            return;
+        }
+
+        entry.pipeline = pipeline;
+        entry.promise.set_value(pipeline);
+    }
+
+    VkResult createPipeline(const GraphicsPipelineDesc& desc, VkPipeline& pipeline) {
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = desc.vertexShader;
+        vertShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = desc.fragmentShader;
+        fragShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+        vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+        vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = desc.topology;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = desc.polygonMode;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = desc.cullMode;
+        rasterizer.frontFace = desc.frontFace;
+        rasterizer.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+
+        VkDynamicState dynamicStates[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+        };
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = desc.layout;
+        pipelineInfo.renderPass = desc.renderPass;
+        pipelineInfo.subpass = desc.subpass;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+        if (desc.renderPass == VK_NULL_HANDLE) {
+            pipelineInfo.pNext = &renderingInfo;
+        }
+
+        return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    }
+};
@@ -0,0 +1,451 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// cpu-side sections of a frame, timed with steady_clock.
+enum class CpuScope : uint32_t {
+    Acquire,
+    Record,
+    Submit,
+    Present,
+    Count
+};
+
+// gpu-side sections of a frame, each bracketed by a pair of timestamp queries.
+enum class GpuScope : uint32_t {
+    Frame,
+    RenderPass,
+    Cull,
+    Count
+};
+
+const uint32_t CPU_SCOPE_COUNT = static_cast<uint32_t>(CpuScope::Count);
+const uint32_t GPU_SCOPE_COUNT = static_cast<uint32_t>(GpuScope::Count);
+
+// counters requested from the pipeline statistics query, in the order the driver writes them back.
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+const uint32_t PIPELINE_STATISTIC_COUNT = 5;
+
+inline const char* cpuScopeName(uint32_t scope) {
+    static const char* names[CPU_SCOPE_COUNT] = {"acquire", "record", "submit", "present"};
+    return names[scope];
+}
+
+inline const char* gpuScopeName(uint32_t scope) {
+    static const char* names[GPU_SCOPE_COUNT] = {"gpu_frame", "gpu_render_pass", "gpu_cull"};
+    return names[scope];
+}
+
+inline const char* pipelineStatisticName(uint32_t statistic) {
+    static const char* names[PIPELINE_STATISTIC_COUNT] = {"ia_vertices", "ia_primitives", "vs_invocations", "clip_primitives", "fs_invocations"};
+    return names[statistic];
+}
+
+struct FrameSample {
+    uint64_t frame = 0;
+    double cpuFrameMs = 0.0;
+    std::array<double, CPU_SCOPE_COUNT> cpuMs{};
+    std::array<double, GPU_SCOPE_COUNT> gpuMs{};
+    std::array<uint64_t, PIPELINE_STATISTIC_COUNT> pipelineStatistics{};
+    bool hasGpu = false;
+    bool hasPipelineStatistics = false;
+};
+
+// fixed-capacity single-producer/single-consumer ring. push and pop never block; a full ring drops the new element.
+template <typename T, size_t Capacity>
+class SpscRing {
+public:
+    bool push(const T& value) {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        size_t next = (head + 1) % Capacity;
+        if (next == readIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        slots[head] = value;
+        writeIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = slots[tail];
+        readIndex.store((tail + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+    std::atomic<size_t> writeIndex{0};
+    std::atomic<size_t> readIndex{0};
+};
+
+// per-frame gpu timestamps, optional pipeline statistics and cpu timers. every entry point returns immediately while disabled.
+//
+// each frame in flight owns its own query pools. results for a slot are read back right after the frame fence for that
+// slot has been waited on, so they are always available and vkGetQueryPoolResults never has to wait.
+class FrameProfiler {
+public:
+    void init(VkDevice device, uint32_t framesInFlight, uint32_t timestampValidBits, float timestampPeriod, bool pipelineStatistics) {
+        this->device = device;
+        this->timestampPeriod = timestampPeriod;
+        gpuTimestamps = timestampValidBits > 0;
+        this->pipelineStatistics = pipelineStatistics;
+
+        slots.resize(framesInFlight);
+
+        for (auto& slot : slots) {
+            if (gpuTimestamps) {
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                poolInfo.queryCount = GPU_SCOPE_COUNT * 2;
+
+                if (vkCreateQueryPool(device, &poolInfo, nullptr, &slot.timestampPool) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create timestamp query pool!");
+                }
+            }
+
+            if (pipelineStatistics) {
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                poolInfo.queryCount = 1;
+                poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+                if (vkCreateQueryPool(device, &poolInfo, nullptr, &slot.statisticsPool) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create pipeline statistics query pool!");
+                }
+            }
+        }
+    }
+
+    void cleanup() {
+        for (auto& slot : slots) {
+            if (slot.timestampPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(device, slot.timestampPool, nullptr);
+            }
+            if (slot.statisticsPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(device, slot.statisticsPool, nullptr);
+            }
+        }
+        slots.clear();
+    }
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    void setEnabled(bool enable) {
+        enabled = enable;
+        std::cout << "profiler " << (enabled ? "enabled" : "disabled") << std::endl;
+    }
+
+    // call after the fence for this slot has been waited on. publishes the frame that last used the slot.
+    void resolveFrame(uint32_t slotIndex) {
+        Slot& slot = slots[slotIndex];
+        if (!slot.pending) {
+            return;
+        }
+        slot.pending = false;
+
+        if (slot.gpuWritten) {
+            uint64_t timestamps[GPU_SCOPE_COUNT * 2];
+            if (vkGetQueryPoolResults(device, slot.timestampPool, 0, GPU_SCOPE_COUNT * 2, sizeof(timestamps), timestamps,
+                                      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+                    slot.sample.gpuMs[i] = (timestamps[i * 2 + 1] - timestamps[i * 2]) * timestampPeriod / 1e6;
+                }
+                slot.sample.hasGpu = true;
+            }
+        }
+
+        if (slot.statisticsWritten) {
+            if (vkGetQueryPoolResults(device, slot.statisticsPool, 0, 1, sizeof(uint64_t) * PIPELINE_STATISTIC_COUNT,
+                                      slot.sample.pipelineStatistics.data(), sizeof(uint64_t) * PIPELINE_STATISTIC_COUNT,
+                                      VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                slot.sample.hasPipelineStatistics = true;
+            }
+        }
+
+        if (!samples.push(slot.sample)) {
+            droppedSamples++;
+        }
+    }
+
+    void beginFrame(uint32_t slotIndex, uint64_t frame) {
+        if (!enabled) {
+            return;
+        }
+
+        Slot& slot = slots[slotIndex];
+        slot.sample = FrameSample{};
+        slot.sample.frame = frame;
+        slot.gpuWritten = false;
+        slot.statisticsWritten = false;
+        slot.pending = true;
+        activeSlot = &slot;
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    void endFrame() {
+        if (!enabled || activeSlot == nullptr) {
+            return;
+        }
+
+        std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+        activeSlot->sample.cpuFrameMs = frameTime.count();
+        activeSlot = nullptr;
+    }
+
+    // drops the frame begun last without recording it, for a frame that ended before anything was submitted.
+    void abandonFrame() {
+        if (activeSlot == nullptr) {
+            return;
+        }
+
+        activeSlot->pending = false;
+        activeSlot = nullptr;
+    }
+
+    void beginCpuScope(CpuScope scope) {
+        if (!enabled) {
+            return;
+        }
+
+        cpuScopeStart[static_cast<uint32_t>(scope)] = std::chrono::steady_clock::now();
+    }
+
+    void endCpuScope(CpuScope scope) {
+        if (!enabled || activeSlot == nullptr) {
+            return;
+        }
+
+        uint32_t index = static_cast<uint32_t>(scope);
+        std::chrono::duration<double, std::milli> scopeTime = std::chrono::steady_clock::now() - cpuScopeStart[index];
+        activeSlot->sample.cpuMs[index] += scopeTime.count();
+    }
+
+    // must be recorded outside of a render pass, before any other profiler command in the buffer.
+    void cmdResetQueries(VkCommandBuffer commandBuffer) {
+        if (!enabled || activeSlot == nullptr) {
+            return;
+        }
+
+        if (gpuTimestamps) {
+            vkCmdResetQueryPool(commandBuffer, activeSlot->timestampPool, 0, GPU_SCOPE_COUNT * 2);
+            activeSlot->gpuWritten = true;
+        }
+        if (pipelineStatistics) {
+            vkCmdResetQueryPool(commandBuffer, activeSlot->statisticsPool, 0, 1);
+        }
+    }
+
+    void cmdBeginGpuScope(VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (!enabled || !gpuTimestamps || activeSlot == nullptr) {
+            return;
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, activeSlot->timestampPool, static_cast<uint32_t>(scope) * 2);
+    }
+
+    void cmdEndGpuScope(VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (!enabled || !gpuTimestamps || activeSlot == nullptr) {
+            return;
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, activeSlot->timestampPool, static_cast<uint32_t>(scope) * 2 + 1);
+    }
+
+    void cmdBeginPipelineStatistics(VkCommandBuffer commandBuffer) {
+        if (!enabled || !pipelineStatistics || activeSlot == nullptr) {
+            return;
+        }
+
+        vkCmdBeginQuery(commandBuffer, activeSlot->statisticsPool, 0, 0);
+    }
+
+    void cmdEndPipelineStatistics(VkCommandBuffer commandBuffer) {
+        if (!enabled || !pipelineStatistics || activeSlot == nullptr) {
+            return;
+        }
+
+        vkCmdEndQuery(commandBuffer, activeSlot->statisticsPool, 0);
+        activeSlot->statisticsWritten = true;
+    }
+
+    // moves every published sample out of the ring. cheap enough to call once per frame from the consumer side.
+    void drain() {
+        FrameSample sample;
+        while (samples.pop(sample)) {
+            history.push_back(sample);
+        }
+    }
+
+    // drains the ring and hands over every frame collected so far, leaving the history empty.
+    std::vector<FrameSample> takeHistory() {
+        drain();
+        std::vector<FrameSample> taken;
+        taken.swap(history);
+        return taken;
+    }
+
+    void printSummary() {
+        drain();
+        if (history.empty()) {
+            return;
+        }
+
+        std::vector<double> cpuFrames;
+        std::vector<double> gpuFrames;
+        for (const auto& sample : history) {
+            cpuFrames.push_back(sample.cpuFrameMs);
+            if (sample.hasGpu) {
+                gpuFrames.push_back(sample.gpuMs[static_cast<uint32_t>(GpuScope::Frame)]);
+            }
+        }
+
+        std::cout << "profiled frames: " << history.size()
+                  << ", cpu p50: " << percentile(cpuFrames, 0.50) << " ms"
+                  << ", cpu p99: " << percentile(cpuFrames, 0.99) << " ms";
+        if (!gpuFrames.empty()) {
+            std::cout << ", gpu p50: " << percentile(gpuFrames, 0.50) << " ms"
+                      << ", gpu p99: " << percentile(gpuFrames, 0.99) << " ms";
+        }
+        if (droppedSamples > 0) {
+            std::cout << ", dropped: " << droppedSamples;
+        }
+        std::cout << std::endl;
+    }
+
+    // writes every collected frame as json when the path ends in .json, csv otherwise.
+    void writeReport(const std::string& path) {
+        drain();
+
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "failed to write profiler report to " << path << std::endl;
+            return;
+        }
+
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json) {
+            writeJson(file);
+        } else {
+            writeCsv(file);
+        }
+    }
+
+    static double percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+private:
+    struct Slot {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        FrameSample sample;
+        bool pending = false;
+        bool gpuWritten = false;
+        bool statisticsWritten = false;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    float timestampPeriod = 1.0f;
+    bool gpuTimestamps = false;
+    bool pipelineStatistics = false;
+    bool enabled = false;
+
+    std::vector<Slot> slots;
+    Slot* activeSlot = nullptr;
+
+    std::chrono::steady_clock::time_point frameStart;
+    std::array<std::chrono::steady_clock::time_point, CPU_SCOPE_COUNT> cpuScopeStart{};
+
+    SpscRing<FrameSample, 1024> samples;
+    uint64_t droppedSamples = 0;
+    std::vector<FrameSample> history;
+
+    void writeCsv(std::ofstream& file) {
+        file << "frame,cpu_frame_ms";
+        for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) {
+            file << "," << cpuScopeName(i) << "_ms";
+        }
+        for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+            file << "," << gpuScopeName(i) << "_ms";
+        }
+        for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+            file << "," << pipelineStatisticName(i);
+        }
+        file << "\n";
+
+        for (const auto& sample : history) {
+            file << sample.frame << "," << sample.cpuFrameMs;
+            for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) {
+                file << "," << sample.cpuMs[i];
+            }
+            for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+                file << ",";
+                if (sample.hasGpu) {
+                    file << sample.gpuMs[i];
+                }
+            }
+            for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+                file << ",";
+                if (sample.hasPipelineStatistics) {
+                    file << sample.pipelineStatistics[i];
+                }
+            }
+            file << "\n";
+        }
+    }
+
+    void writeJson(std::ofstream& file) {
+        file << "{\n  \"frames\": [\n";
+        for (size_t f = 0; f < history.size(); f++) {
+            const FrameSample& sample = history[f];
+            file << "    {\"frame\": " << sample.frame << ", \"cpu_frame_ms\": " << sample.cpuFrameMs;
+            for (uint32_t i = 0; i < CPU_SCOPE_COUNT; i++) {
+                file << ", \"" << cpuScopeName(i) << "_ms\": " << sample.cpuMs[i];
+            }
+            if (sample.hasGpu) {
+                for (uint32_t i = 0; i < GPU_SCOPE_COUNT; i++) {
+                    file << ", \"" << gpuScopeName(i) << "_ms\": " << sample.gpuMs[i];
+                }
+            }
+            if (sample.hasPipelineStatistics) {
+                for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+                    file << ", \"" << pipelineStatisticName(i) << "\": " << sample.pipelineStatistics[i];
+                }
+            }
+            file << "}" << (f + 1 < history.size() ? "," : "") << "\n";
+        }
+        file << "  ]\n}\n";
+    }
+};
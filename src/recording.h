@@ -0,0 +1,252 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads that all run the same job and then park again.
+//
+// the calling thread is worker 0, so a pool of one never touches another thread and is a fair single-core baseline.
+class WorkerPool {
+public:
+    explicit WorkerPool(uint32_t workerCount) : workerCount(workerCount == 0 ? 1 : workerCount) {
+        for (uint32_t i = 1; i < this->workerCount; i++) {
+            threads.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    uint32_t size() const {
+        return workerCount;
+    }
+
+    // runs job(workerIndex) once on every worker and returns when all of them are done. the first exception thrown by
+    // any worker is rethrown here.
+    void run(const std::function<void(uint32_t)>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentJob = &job;
+            pending = workerCount - 1;
+            failure = nullptr;
+            generation++;
+        }
+        wake.notify_all();
+
+        runJob(job, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        currentJob = nullptr;
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+private:
+    uint32_t workerCount;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(uint32_t)>* currentJob = nullptr;
+    uint64_t generation = 0;
+    uint32_t pending = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void runJob(const std::function<void(uint32_t)>& job, uint32_t index) {
+        try {
+            job(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    }
+
+    void workerLoop(uint32_t index) {
+        uint64_t seen = 0;
+
+        while (true) {
+            const std::function<void(uint32_t)>* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                job = currentJob;
+            }
+
+            runJob(*job, index);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            done.notify_one();
+        }
+    }
+};
+
+// records the draws of a render pass in parallel into secondary command buffers.
+//
+// every worker owns one command pool per frame in flight, so a worker only ever touches its own pool and a frame's
+// pools can be reset wholesale once that frame's fence has signalled, without freeing individual buffers.
+class ParallelRecorder {
+public:
+    // records draws [first, first + count) of the pass into an already begun secondary command buffer.
+    using RecordFn = std::function<void(VkCommandBuffer, uint32_t first, uint32_t count)>;
+
+    void init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, uint32_t workerCount) {
+        this->device = device;
+        workers.reset(new WorkerPool(workerCount));
+
+        frames.resize(framesInFlight);
+        for (auto& frame : frames) {
+            frame.commandPools.resize(workers->size());
+            frame.commandBuffers.resize(workers->size());
+
+            for (uint32_t i = 0; i < workers->size(); i++) {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex = queueFamily;
+
+                if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPools[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create worker command pool!");
+                }
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = frame.commandPools[i];
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+
+                if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffers[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate secondary command buffer!");
+                }
+            }
+        }
+    }
+
+    void cleanup() {
+        for (auto& frame : frames) {
+            for (auto commandPool : frame.commandPools) {
+                vkDestroyCommandPool(device, commandPool, nullptr);
+            }
+        }
+        frames.clear();
+        workers.reset();
+    }
+
+    uint32_t workerCount() const {
+        return workers ? workers->size() : 0;
+    }
+
+    // the pipeline statistics a query active in the primary counts while the secondaries execute. needs the
+    // inheritedQueries feature; without it no such query may be active.
+    void inheritPipelineStatistics(VkQueryPipelineStatisticFlags statistics) {
+        inheritedStatistics = statistics;
+    }
+
+    // splits drawCount draws evenly over the workers and returns the secondaries to execute, in draw order. the caller
+    // must have waited for the previous use of this frame slot; framebuffer may be VK_NULL_HANDLE.
+    const std::vector<VkCommandBuffer>& record(uint32_t frame, VkRenderPass renderPass, uint32_t subpass,
+                                               VkFramebuffer framebuffer, uint32_t drawCount, const RecordFn& recordDraws) {
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = subpass;
+        inheritanceInfo.framebuffer = framebuffer;
+        inheritanceInfo.pipelineStatistics = inheritedStatistics;
+
+        return recordSecondaries(frame, inheritanceInfo, drawCount, recordDraws);
+    }
+
+    // the same for draws inside vkCmdBeginRenderingKHR with SECONDARY_COMMAND_BUFFERS contents, rendering into a single
+    // color attachment of colorFormat.
+    const std::vector<VkCommandBuffer>& record(uint32_t frame, VkFormat colorFormat, uint32_t drawCount, const RecordFn& recordDraws) {
+        VkCommandBufferInheritanceRenderingInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &colorFormat;
+        renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.pNext = &renderingInfo;
+        inheritanceInfo.pipelineStatistics = inheritedStatistics;
+
+        return recordSecondaries(frame, inheritanceInfo, drawCount, recordDraws);
+    }
+
+private:
+    struct FrameResources {
+        std::vector<VkCommandPool> commandPools;
+        std::vector<VkCommandBuffer> commandBuffers;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::unique_ptr<WorkerPool> workers;
+    std::vector<FrameResources> frames;
+    VkQueryPipelineStatisticFlags inheritedStatistics = 0;
+
+    const std::vector<VkCommandBuffer>& recordSecondaries(uint32_t frame, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                                                          uint32_t drawCount, const RecordFn& recordDraws) {
+        FrameResources& resources = frames[frame];
+        uint32_t workerTotal = workers->size();
+
+        workers->run([&](uint32_t worker) {
+            vkResetCommandPool(device, resources.commandPools[worker], 0);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+            VkCommandBuffer commandBuffer = resources.commandBuffers[worker];
+            if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin recording secondary command buffer!");
+            }
+
+            uint32_t first = static_cast<uint32_t>(uint64_t(drawCount) * worker / workerTotal);
+            uint32_t last = static_cast<uint32_t>(uint64_t(drawCount) * (worker + 1) / workerTotal);
+            if (last > first) {
+                recordDraws(commandBuffer, first, last - first);
+            }
+
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+        });
+
+        return resources.commandBuffers;
+    }
+};
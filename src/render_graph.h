@@ -0,0 +1,707 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class GraphPassType : uint32_t {
+    Graphics,
+    Compute,
+    Transfer
+};
+
+// how a pass uses an image. each maps to the stages, access mask and layout the barriers are derived from.
+enum class GraphAccess : uint32_t {
+    ColorAttachmentWrite,
+    DepthAttachmentWrite,
+    DepthAttachmentRead,
+    SampledRead,
+    StorageRead,
+    StorageWrite,
+    TransferRead,
+    TransferWrite
+};
+
+struct GraphStats {
+    uint32_t passCount = 0;
+    uint32_t culledPassCount = 0;
+    // one barrier in front of every access, which is what hand-written code without tracking ends up with.
+    uint32_t accessCount = 0;
+    uint32_t imageBarriers = 0;
+    uint32_t barrierCalls = 0;
+    uint32_t layoutTransitions = 0;
+    uint32_t aliasingBarriers = 0;
+    // reads that needed no barrier of their own because an earlier one already made the image visible to them.
+    uint32_t coveredReads = 0;
+    // transitions of imported images to their final layout after the last pass.
+    uint32_t finalTransitions = 0;
+    uint32_t transientCount = 0;
+    uint32_t memoryBlockCount = 0;
+    VkDeviceSize unaliasedBytes = 0;
+    VkDeviceSize aliasedBytes = 0;
+};
+
+// a frame described as passes and the images they read and write, instead of as hand-placed barriers.
+//
+// compile() orders the passes by their dependencies, drops passes nothing needs, works out which transient images can
+// share memory because their lifetimes never overlap, and derives the smallest set of barriers and layout transitions
+// between the passes that remain. compile() touches no device: image sizes are estimated from the formats and extents
+// alone, so a graph can be planned and checked without one.
+//
+// a pass that writes an image another pass already wrote loads and modifies it, so writers run in the order they were
+// added and every reader runs after the last of them. a pass may use each image once.
+class RenderGraph {
+public:
+    uint32_t createImage(const std::string& name, VkFormat format, VkExtent2D extent) {
+        Resource resource{};
+        resource.name = name;
+        resource.format = format;
+        resource.extent = extent;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    // an image the graph does not own, such as a swap chain image. it is always an output, so whatever writes it is
+    // never culled, and it is left in finalLayout at the end of the frame.
+    uint32_t importImage(const std::string& name, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout,
+                         VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) {
+        uint32_t index = createImage(name, format, extent);
+        Resource& resource = resources[index];
+        resource.imported = true;
+        resource.output = true;
+        resource.initialLayout = initialLayout;
+        resource.finalLayout = finalLayout;
+        resource.initialStage = initialStage;
+        return index;
+    }
+
+    // keeps a transient image's writers alive even though no pass reads it, e.g. for a readback outside the graph.
+    void markOutput(uint32_t resource) {
+        resources[resource].output = true;
+    }
+
+    uint32_t addPass(const std::string& name, GraphPassType type) {
+        Pass pass{};
+        pass.name = name;
+        pass.type = type;
+        passes.push_back(pass);
+        return static_cast<uint32_t>(passes.size() - 1);
+    }
+
+    void use(uint32_t pass, uint32_t resource, GraphAccess access) {
+        for (const auto& existing : passes[pass].uses) {
+            if (existing.resource == resource) {
+                throw std::runtime_error("render graph pass " + passes[pass].name + " uses " + resources[resource].name + " twice!");
+            }
+        }
+        passes[pass].uses.push_back({resource, access});
+    }
+
+    void compile() {
+        sortPasses();
+        cullPasses();
+        computeLifetimes();
+        planMemory();
+        deriveBarriers();
+    }
+
+    const GraphStats& statistics() const {
+        return stats;
+    }
+
+    // the names of the live passes in the order compile() put them.
+    std::vector<std::string> passOrder() const {
+        std::vector<std::string> names;
+        for (uint32_t index : order) {
+            names.push_back(passes[index].name);
+        }
+        return names;
+    }
+
+    // the names of the passes compile() dropped, in the order they were added.
+    std::vector<std::string> culledPasses() const {
+        std::vector<std::string> names;
+        for (const auto& pass : passes) {
+            if (!pass.live) {
+                names.push_back(pass.name);
+            }
+        }
+        return names;
+    }
+
+    // checks the compiled graph against what compile() promises and returns a description of every violation: each live
+    // pass runs after the passes whose writes it depends on, no pass that writes an output is culled, images that share
+    // a block are never alive at once and fit it, and replaying the barriers puts every image in the layout each access
+    // needs, makes the access's stages wait and leaves imported images in their final layout.
+    std::vector<std::string> checkInvariants() const {
+        std::vector<std::string> violations;
+
+        std::vector<uint32_t> stepOf(passes.size(), UINT32_MAX);
+        for (uint32_t step = 0; step < order.size(); step++) {
+            stepOf[order[step]] = step;
+        }
+        for (uint32_t step = 0; step < order.size(); step++) {
+            const Pass& pass = passes[order[step]];
+            for (const auto& use : pass.uses) {
+                const auto& writers = resources[use.resource].writers;
+                auto position = std::find(writers.begin(), writers.end(), order[step]);
+                uint32_t before = UINT32_MAX;
+                if (writes(use) && position != writers.begin()) {
+                    before = *(position - 1);
+                } else if (!writes(use) && !writers.empty()) {
+                    before = writers.back();
+                }
+                if (before != UINT32_MAX && stepOf[before] >= step) {
+                    violations.push_back(pass.name + " runs before " + passes[before].name + ", which writes " +
+                                         resources[use.resource].name + " first");
+                }
+            }
+        }
+
+        for (const auto& pass : passes) {
+            for (const auto& use : pass.uses) {
+                if (!pass.live && writes(use) && resources[use.resource].output) {
+                    violations.push_back(pass.name + " is culled but writes the output " + resources[use.resource].name);
+                }
+            }
+        }
+
+        for (const auto& block : blocks) {
+            for (uint32_t index : block.resources) {
+                const Resource& resource = resources[index];
+                if (resource.size > block.size) {
+                    violations.push_back(resource.name + " does not fit its memory block");
+                }
+                for (uint32_t other : block.resources) {
+                    if (other != index && resources[other].firstUse <= resource.lastUse && resource.firstUse <= resources[other].lastUse) {
+                        violations.push_back(resource.name + " shares memory with " + resources[other].name + " while both are alive");
+                    }
+                }
+            }
+        }
+
+        std::vector<VkImageLayout> layouts(resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+        for (size_t i = 0; i < resources.size(); i++) {
+            layouts[i] = resources[i].imported ? resources[i].initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+        auto replay = [&](const BarrierBatch& batch) {
+            for (const auto& barrier : batch.barriers) {
+                if (barrier.oldLayout != layouts[barrier.resource]) {
+                    violations.push_back("a barrier moves " + resources[barrier.resource].name + " out of a layout it is not in");
+                }
+                layouts[barrier.resource] = barrier.newLayout;
+            }
+        };
+        for (uint32_t step = 0; step < order.size(); step++) {
+            const Pass& pass = passes[order[step]];
+            replay(batches[step]);
+            for (const auto& use : pass.uses) {
+                AccessInfo info = accessInfo(use.access, pass.type);
+                if (layouts[use.resource] != info.layout) {
+                    violations.push_back(pass.name + " uses " + resources[use.resource].name + " in the wrong layout");
+                }
+                if (step == resources[use.resource].firstUse && (batches[step].dstStages & info.stages) != info.stages) {
+                    violations.push_back(pass.name + " does not wait for anything before its first use of " + resources[use.resource].name);
+                }
+            }
+        }
+        replay(batches.back());
+        for (size_t i = 0; i < resources.size(); i++) {
+            if (resources[i].imported && resources[i].live() && layouts[i] != resources[i].finalLayout) {
+                violations.push_back(resources[i].name + " is not left in its final layout");
+            }
+        }
+        return violations;
+    }
+
+    void printReport(std::ostream& out) const {
+        out << "render graph: " << stats.passCount << " passes, " << stats.culledPassCount << " culled";
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (!passes[i].live) {
+                out << (i == firstCulled() ? " (" : ", ") << passes[i].name;
+            }
+        }
+        out << (stats.culledPassCount > 0 ? ")" : "") << std::endl;
+
+        out << "  order:";
+        for (size_t step = 0; step < order.size(); step++) {
+            out << (step == 0 ? " " : " -> ") << passes[order[step]].name;
+        }
+        out << std::endl;
+
+        out << "  barriers: " << stats.imageBarriers << " image barriers in " << stats.barrierCalls << " calls for "
+            << stats.accessCount << " accesses, " << stats.coveredReads << " reads covered by an earlier barrier, "
+            << stats.layoutTransitions << " layout transitions, " << stats.aliasingBarriers << " aliasing" << std::endl;
+
+        for (size_t i = 0; i < resources.size(); i++) {
+            const Resource& resource = resources[i];
+            if (!resource.live()) {
+                continue;
+            }
+            out << "  " << std::left << std::setw(16) << resource.name << std::right << " passes " << resource.firstUse << "-"
+                << resource.lastUse;
+            if (resource.imported) {
+                out << ", imported";
+            } else {
+                out << ", block " << resource.block << ", " << std::fixed << std::setprecision(1) << mebibytes(resource.size) << " MiB";
+            }
+            out << std::endl;
+        }
+
+        double saved = stats.unaliasedBytes > 0 ? 100.0 * (1.0 - static_cast<double>(stats.aliasedBytes) / stats.unaliasedBytes) : 0.0;
+        out << "  transient memory: " << std::fixed << std::setprecision(1) << mebibytes(stats.unaliasedBytes) << " MiB for "
+            << stats.transientCount << " images, " << mebibytes(stats.aliasedBytes) << " MiB aliased into " << stats.memoryBlockCount
+            << " blocks (" << std::setprecision(0) << saved << "% saved)" << std::endl;
+    }
+
+private:
+    struct Use {
+        uint32_t resource;
+        GraphAccess access;
+    };
+
+    struct Pass {
+        std::string name;
+        GraphPassType type = GraphPassType::Graphics;
+        std::vector<Use> uses;
+        bool live = false;
+    };
+
+    struct Resource {
+        std::string name;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        bool imported = false;
+        bool output = false;
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        // filled in by compile(). firstUse and lastUse are steps in the pass order.
+        std::vector<uint32_t> writers;
+        uint32_t firstUse = UINT32_MAX;
+        uint32_t lastUse = 0;
+        VkDeviceSize size = 0;
+        uint32_t block = UINT32_MAX;
+        // the image whose memory this one takes over, or UINT32_MAX if it is the first in its block.
+        uint32_t aliases = UINT32_MAX;
+
+        bool live() const {
+            return firstUse != UINT32_MAX;
+        }
+    };
+
+    struct MemoryBlock {
+        std::vector<uint32_t> resources;
+        VkDeviceSize size = 0;
+    };
+
+    struct AccessInfo {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        bool write;
+    };
+
+    struct ImageBarrier {
+        uint32_t resource;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+    };
+
+    // every barrier a pass needs goes into one vkCmdPipelineBarrier.
+    struct BarrierBatch {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<ImageBarrier> barriers;
+    };
+
+    // what has happened to an image so far in the frame: its layout, the last write and the reads that have already
+    // been made visible since then.
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        VkAccessFlags readAccess = 0;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<uint32_t> order;
+    std::vector<MemoryBlock> blocks;
+    // one batch in front of each step in order, plus the final transitions of imported images.
+    std::vector<BarrierBatch> batches;
+    GraphStats stats;
+
+    // bytes per texel, used to estimate image sizes without a device to ask.
+    static uint32_t formatSize(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+                return 1;
+            case VK_FORMAT_R8G8_UNORM:
+            case VK_FORMAT_R16_SFLOAT:
+            case VK_FORMAT_D16_UNORM:
+                return 2;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R32G32_SFLOAT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return 16;
+            default:
+                return 4;
+        }
+    }
+
+    static double mebibytes(VkDeviceSize bytes) {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+
+    static AccessInfo accessInfo(GraphAccess access, GraphPassType type) {
+        VkPipelineStageFlags shaderStages = type == GraphPassType::Compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                                           : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+        switch (access) {
+            case GraphAccess::ColorAttachmentWrite:
+                return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+            case GraphAccess::DepthAttachmentWrite:
+                return {depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+            case GraphAccess::DepthAttachmentRead:
+                return {depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false};
+            case GraphAccess::SampledRead:
+                return {shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+            case GraphAccess::StorageRead:
+                return {shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+            case GraphAccess::StorageWrite:
+                return {shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true};
+            case GraphAccess::TransferRead:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+            case GraphAccess::TransferWrite:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+        }
+        throw std::runtime_error("unknown render graph access!");
+    }
+
+    bool writes(const Use& use) const {
+        return accessInfo(use.access, GraphPassType::Graphics).write;
+    }
+
+    size_t firstCulled() const {
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (!passes[i].live) {
+                return i;
+            }
+        }
+        return passes.size();
+    }
+
+    // writers of an image run in the order they were added and its readers after the last of them. among passes that
+    // are free to go, the one added first goes first, so a graph that is already in order keeps that order.
+    void sortPasses() {
+        for (auto& resource : resources) {
+            resource.writers.clear();
+        }
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            for (const auto& use : passes[i].uses) {
+                if (writes(use)) {
+                    resources[use.resource].writers.push_back(i);
+                }
+            }
+        }
+
+        std::vector<std::set<uint32_t>> dependents(passes.size());
+        std::vector<uint32_t> dependencyCount(passes.size(), 0);
+        auto addDependency = [&](uint32_t before, uint32_t after) {
+            if (dependents[before].insert(after).second) {
+                dependencyCount[after]++;
+            }
+        };
+
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            for (const auto& use : passes[i].uses) {
+                const auto& writers = resources[use.resource].writers;
+                if (writes(use)) {
+                    auto position = std::find(writers.begin(), writers.end(), i);
+                    if (position != writers.begin()) {
+                        addDependency(*(position - 1), i);
+                    }
+                } else if (!writers.empty()) {
+                    addDependency(writers.back(), i);
+                }
+            }
+        }
+
+        order.clear();
+        std::set<uint32_t> ready;
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            if (dependencyCount[i] == 0) {
+                ready.insert(i);
+            }
+        }
+        while (!ready.empty()) {
+            uint32_t pass = *ready.begin();
+            ready.erase(ready.begin());
+            order.push_back(pass);
+            for (uint32_t dependent : dependents[pass]) {
+                if (--dependencyCount[dependent] == 0) {
+                    ready.insert(dependent);
+                }
+            }
+        }
+
+        if (order.size() != passes.size()) {
+            throw std::runtime_error("render graph has a dependency cycle!");
+        }
+    }
+
+    // walks the order backwards from the outputs: a pass lives if it writes something a live pass or the caller needs.
+    void cullPasses() {
+        std::vector<bool> needed(resources.size(), false);
+        for (size_t i = 0; i < resources.size(); i++) {
+            needed[i] = resources[i].output;
+        }
+
+        for (auto step = order.rbegin(); step != order.rend(); ++step) {
+            Pass& pass = passes[*step];
+            pass.live = false;
+            for (const auto& use : pass.uses) {
+                if (writes(use) && needed[use.resource]) {
+                    pass.live = true;
+                }
+            }
+            if (!pass.live) {
+                continue;
+            }
+            for (const auto& use : pass.uses) {
+                needed[use.resource] = true;
+            }
+        }
+
+        std::vector<uint32_t> liveOrder;
+        for (uint32_t index : order) {
+            if (passes[index].live) {
+                liveOrder.push_back(index);
+            }
+        }
+
+        stats = GraphStats{};
+        stats.passCount = static_cast<uint32_t>(passes.size());
+        stats.culledPassCount = static_cast<uint32_t>(order.size() - liveOrder.size());
+        order = liveOrder;
+    }
+
+    void computeLifetimes() {
+        for (auto& resource : resources) {
+            resource.firstUse = UINT32_MAX;
+            resource.lastUse = 0;
+        }
+
+        for (uint32_t step = 0; step < order.size(); step++) {
+            const Pass& pass = passes[order[step]];
+            for (const auto& use : pass.uses) {
+                Resource& resource = resources[use.resource];
+                AccessInfo info = accessInfo(use.access, pass.type);
+                if (!resource.live() && !resource.imported && !info.write) {
+                    throw std::runtime_error("render graph pass " + pass.name + " reads " + resource.name + " before anything writes it!");
+                }
+                resource.firstUse = std::min(resource.firstUse, step);
+                resource.lastUse = std::max(resource.lastUse, step);
+                stats.accessCount++;
+            }
+        }
+    }
+
+    // first fit, largest images first: an image joins the first block whose images are all dead before it is first
+    // used or born after it was last used. a block is as large as its largest image.
+    void planMemory() {
+        std::vector<uint32_t> transients;
+        for (uint32_t i = 0; i < resources.size(); i++) {
+            resources[i].block = UINT32_MAX;
+            resources[i].aliases = UINT32_MAX;
+            if (!resources[i].imported && resources[i].live()) {
+                resources[i].size = static_cast<VkDeviceSize>(resources[i].extent.width) * resources[i].extent.height *
+                                    formatSize(resources[i].format);
+                transients.push_back(i);
+            }
+        }
+        std::stable_sort(transients.begin(), transients.end(),
+                         [&](uint32_t a, uint32_t b) { return resources[a].size > resources[b].size; });
+
+        blocks.clear();
+        stats.transientCount = static_cast<uint32_t>(transients.size());
+        stats.unaliasedBytes = 0;
+        for (uint32_t index : transients) {
+            Resource& resource = resources[index];
+            stats.unaliasedBytes += resource.size;
+
+            for (uint32_t b = 0; b < blocks.size() && resource.block == UINT32_MAX; b++) {
+                const MemoryBlock& block = blocks[b];
+                bool overlaps = std::any_of(block.resources.begin(), block.resources.end(), [&](uint32_t other) {
+                    return resources[other].firstUse <= resource.lastUse && resource.firstUse <= resources[other].lastUse;
+                });
+                if (!overlaps) {
+                    resource.block = b;
+                }
+            }
+
+            if (resource.block == UINT32_MAX) {
+                resource.block = static_cast<uint32_t>(blocks.size());
+                blocks.emplace_back();
+            }
+
+            MemoryBlock& block = blocks[resource.block];
+            block.resources.push_back(index);
+            block.size = std::max(block.size, resource.size);
+        }
+
+        // within a block, each image takes the memory over from whichever image used it last before it.
+        stats.aliasedBytes = 0;
+        for (auto& block : blocks) {
+            stats.aliasedBytes += block.size;
+            for (uint32_t index : block.resources) {
+                Resource& resource = resources[index];
+                for (uint32_t other : block.resources) {
+                    if (resources[other].lastUse < resource.firstUse &&
+                        (resource.aliases == UINT32_MAX || resources[other].lastUse > resources[resource.aliases].lastUse)) {
+                        resource.aliases = other;
+                    }
+                }
+            }
+        }
+        stats.memoryBlockCount = static_cast<uint32_t>(blocks.size());
+    }
+
+    void deriveBarriers() {
+        std::vector<ResourceState> states(resources.size());
+        for (size_t i = 0; i < resources.size(); i++) {
+            if (resources[i].imported) {
+                states[i].layout = resources[i].initialLayout;
+                states[i].writeStages = resources[i].initialStage;
+            }
+        }
+
+        stats.imageBarriers = 0;
+        stats.barrierCalls = 0;
+        stats.layoutTransitions = 0;
+        stats.aliasingBarriers = 0;
+        stats.coveredReads = 0;
+        stats.finalTransitions = 0;
+        batches.assign(order.size() + 1, BarrierBatch{});
+
+        for (uint32_t step = 0; step < order.size(); step++) {
+            const Pass& pass = passes[order[step]];
+            BarrierBatch& batch = batches[step];
+
+            for (const auto& use : pass.uses) {
+                Resource& resource = resources[use.resource];
+                ResourceState& state = states[use.resource];
+                AccessInfo info = accessInfo(use.access, pass.type);
+
+                // the memory was last used by another image, which has to be done with it before this one moves in.
+                if (step == resource.firstUse && resource.aliases != UINT32_MAX) {
+                    const ResourceState& previous = states[resource.aliases];
+                    state.writeStages = previous.writeStages | previous.readStages;
+                    state.writeAccess = previous.writeAccess;
+                    stats.aliasingBarriers++;
+                }
+
+                bool transition = state.layout != info.layout;
+                if (!info.write) {
+                    // a barrier for a read covers the later passes that read in the same layout too, so they need none.
+                    widenToLaterReads(step, use.resource, info);
+                }
+                VkPipelineStageFlags srcStages = state.writeStages;
+                VkAccessFlags srcAccess = state.writeAccess;
+
+                if (info.write) {
+                    // a write waits for every earlier read as well, but only their execution.
+                    srcStages |= state.readStages;
+                    if (transition || srcStages != 0) {
+                        addBarrier(batch, use.resource, state.layout, info, srcStages, srcAccess);
+                    }
+                    state.writeStages = info.stages;
+                    state.writeAccess = info.access;
+                    state.readStages = 0;
+                    state.readAccess = 0;
+                } else if (transition) {
+                    // the transition is a write of its own, so earlier reads are no longer enough to skip a barrier.
+                    addBarrier(batch, use.resource, state.layout, info, srcStages | state.readStages, srcAccess);
+                    state.writeStages = info.stages;
+                    state.writeAccess = 0;
+                    state.readStages = info.stages;
+                    state.readAccess = info.access;
+                } else if ((state.readStages & info.stages) != info.stages || (state.readAccess & info.access) != info.access) {
+                    // a read after a read that already waited for the same write at the same stage needs nothing.
+                    if (srcStages != 0) {
+                        addBarrier(batch, use.resource, state.layout, info, srcStages, srcAccess);
+                    }
+                    state.readStages |= info.stages;
+                    state.readAccess |= info.access;
+                } else {
+                    stats.coveredReads++;
+                }
+                state.layout = info.layout;
+            }
+        }
+
+        BarrierBatch& finalBatch = batches.back();
+        for (size_t i = 0; i < resources.size(); i++) {
+            const Resource& resource = resources[i];
+            const ResourceState& state = states[i];
+            if (!resource.imported || !resource.live() || state.layout == resource.finalLayout) {
+                continue;
+            }
+            AccessInfo info{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, resource.finalLayout, false};
+            addBarrier(finalBatch, static_cast<uint32_t>(i), state.layout, info, state.writeStages | state.readStages, state.writeAccess);
+            stats.finalTransitions++;
+        }
+
+        for (const auto& batch : batches) {
+            if (!batch.barriers.empty()) {
+                stats.barrierCalls++;
+            }
+        }
+    }
+
+    void widenToLaterReads(uint32_t step, uint32_t resource, AccessInfo& info) const {
+        for (uint32_t later = step + 1; later < order.size(); later++) {
+            const Pass& pass = passes[order[later]];
+            for (const auto& use : pass.uses) {
+                if (use.resource != resource) {
+                    continue;
+                }
+                AccessInfo laterInfo = accessInfo(use.access, pass.type);
+                if (laterInfo.write || laterInfo.layout != info.layout) {
+                    return;
+                }
+                info.stages |= laterInfo.stages;
+                info.access |= laterInfo.access;
+            }
+        }
+    }
+
+    void addBarrier(BarrierBatch& batch, uint32_t resource, VkImageLayout oldLayout, const AccessInfo& info, VkPipelineStageFlags srcStages,
+                    VkAccessFlags srcAccess) {
+        batch.srcStages |= srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        batch.dstStages |= info.stages;
+        batch.barriers.push_back({resource, oldLayout, info.layout, srcAccess, info.access});
+
+        stats.imageBarriers++;
+        if (oldLayout != info.layout) {
+            stats.layoutTransitions++;
+        }
+    }
+};
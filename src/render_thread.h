@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// a fixed-size ring between exactly one producer thread and one consumer thread. neither side ever blocks or locks:
+// each owns one index and publishes it with release, so the other side sees a slot's contents once it sees the index
+// move past it.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    // producer only. false when the ring is full, and the item is not queued.
+    bool push(const T& item) {
+        size_t back = tail.load(std::memory_order_relaxed);
+        if (back - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[back & (Capacity - 1)] = item;
+        tail.store(back + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only. false when the ring is empty.
+    bool pop(T& item) {
+        size_t front = head.load(std::memory_order_relaxed);
+        if (front == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[front & (Capacity - 1)];
+        head.store(front + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+    // on cache lines of their own, so the two threads do not keep taking the line from each other.
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// hands the latest value of some state from one writer thread to one reader thread. of the three slots the writer owns
+// one, the reader another, and the third sits between them: publishing swaps the writer's slot with it, reading swaps it
+// with the reader's. neither side waits for the other, and the reader always gets the newest complete value, skipping
+// the ones it was too slow for.
+template <typename T>
+class TripleBuffer {
+public:
+    // writer only: the slot to fill before publish().
+    T& back() {
+        return slots[backIndex];
+    }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // reader only: moves front() to the newest published value. false when nothing was published since the last call.
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static constexpr uint32_t INDEX_MASK = 3;
+    static constexpr uint32_t FRESH = 4;
+
+    std::array<T, 3> slots{};
+    uint32_t backIndex = 0;
+    alignas(64) std::atomic<uint32_t> middle{1};
+    alignas(64) uint32_t frontIndex = 2;
+};
+
+// what the event thread tells the render thread about, stamped with when glfw delivered it.
+struct InputEvent {
+    enum class Type : uint32_t {
+        Key,
+        // the window system lost the window's contents.
+        Refresh
+    };
+
+    Type type = Type::Key;
+    int key = 0;
+    int action = 0;
+    std::chrono::steady_clock::time_point time;
+};
+
+// the window as the event thread last saw it. glfw may only be asked about it on the main thread.
+struct WindowState {
+    int width = 0;
+    int height = 0;
+};
+
+// everything the event thread and the render thread share while the render thread runs. input events go through a
+// queue, so none is lost between two frames; the window state is only ever needed as of now, so it goes through a
+// triple buffer. the mutex serves only to put the render thread to sleep and wake it; no data passes under it.
+class RenderThreadLink {
+public:
+    static constexpr size_t INPUT_CAPACITY = 256;
+
+    // event thread. a full queue drops the event and counts it.
+    void pushInput(const InputEvent& event) {
+        if (!input.push(event)) {
+            droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake();
+    }
+
+    // event thread.
+    void publishWindowState(const WindowState& state) {
+        windowState.back() = state;
+        windowState.publish();
+        wake();
+    }
+
+    // render thread.
+    bool popInput(InputEvent& event) {
+        return input.pop(event);
+    }
+
+    // render thread: true when the window state changed since the last call; state is the newest either way.
+    bool updateWindowState(WindowState& state) {
+        bool changed = windowState.update();
+        state = windowState.front();
+        return changed;
+    }
+
+    // render thread: sleeps until the event thread has something, a stop is requested or timeoutSeconds pass. a
+    // negative timeout waits without one.
+    void waitForInput(double timeoutSeconds) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto ready = [this]() { return woken || stopRequested(); };
+        if (timeoutSeconds < 0.0) {
+            wakeup.wait(lock, ready);
+        } else {
+            wakeup.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), ready);
+        }
+        woken = false;
+    }
+
+    void requestStop() {
+        stop.store(true, std::memory_order_release);
+        wake();
+    }
+
+    bool stopRequested() const {
+        return stop.load(std::memory_order_acquire);
+    }
+
+    // render thread: the loop has ended, by a stop or an error.
+    void finish() {
+        finished.store(true, std::memory_order_release);
+    }
+
+    bool isFinished() const {
+        return finished.load(std::memory_order_acquire);
+    }
+
+    uint64_t droppedInput() const {
+        return droppedEvents.load(std::memory_order_relaxed);
+    }
+
+private:
+    SpscQueue<InputEvent, INPUT_CAPACITY> input;
+    TripleBuffer<WindowState> windowState;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool woken = false;
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> finished{false};
+    std::atomic<uint64_t> droppedEvents{0};
+
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            woken = true;
+        }
+        wakeup.notify_one();
+    }
+};
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// read-only view of a whole file through the os page cache. the mapping is page aligned, so SPIR-V can be handed to
+// vkCreateShaderModule straight from it without a copy.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            close();
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(info.st_size);
+
+        void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close();
+            return false;
+        }
+        view = address;
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (view != nullptr) {
+            UnmapViewOfFile(view);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (view != nullptr) {
+            munmap(view, mappedSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+#endif
+        view = nullptr;
+        mappedSize = 0;
+    }
+
+    const char* data() const {
+        return static_cast<const char*>(view);
+    }
+
+    size_t size() const {
+        return mappedSize;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    void* view = nullptr;
+    size_t mappedSize = 0;
+};
+
+// 64-bit FNV-1a. used for shader names and contents; the contents key also includes the size.
+inline uint64_t hashBytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// rejects anything vkCreateShaderModule could choke on: a truncated header, a size that is not whole words, a pointer
+// that is not word aligned, or the wrong magic (which also catches SPIR-V written with the other endianness).
+inline bool isValidSpirv(const void* code, size_t size) {
+    if (size < 5 * sizeof(uint32_t) || size % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+        return false;
+    }
+    return *static_cast<const uint32_t*>(code) == SPIRV_MAGIC;
+}
+
+// a single file holding many SPIR-V blobs behind a hash index.
+//
+// layout (little endian): a header, then entryCount entries sorted by name hash, then the blobs, each starting on a
+// 16 byte boundary. the whole archive is mapped once and every lookup is a binary search over the entries.
+class ShaderArchive {
+public:
+    static constexpr uint32_t MAGIC = 0x4b415053; // "SPAK"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        uint64_t nameHash;
+        uint64_t contentHash;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    bool open(const std::string& path) {
+        if (!file.open(path) || file.size() < sizeof(Header)) {
+            return false;
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != MAGIC || header.version != VERSION ||
+            sizeof(Header) + uint64_t(header.entryCount) * sizeof(Entry) > file.size()) {
+            file.close();
+            return false;
+        }
+
+        entries = reinterpret_cast<const Entry*>(file.data() + sizeof(Header));
+        entryCount = header.entryCount;
+        return true;
+    }
+
+    bool isOpen() const {
+        return file.data() != nullptr;
+    }
+
+    // finds the blob stored under name. code points into the mapping and stays valid while the archive is open.
+    bool find(const std::string& name, const void*& code, size_t& size, uint64_t& contentHash) const {
+        uint64_t nameHash = hashBytes(name.data(), name.size());
+        const Entry* last = entries + entryCount;
+        const Entry* entry = std::lower_bound(entries, last, nameHash,
+                                              [](const Entry& e, uint64_t hash) { return e.nameHash < hash; });
+
+        if (entry == last || entry->nameHash != nameHash || entry->offset > file.size() ||
+            entry->size > file.size() - entry->offset) {
+            return false;
+        }
+
+        code = file.data() + entry->offset;
+        size = static_cast<size_t>(entry->size);
+        contentHash = entry->contentHash;
+        return true;
+    }
+
+    // packs every .spv file in directory into an archive at path and returns how many were stored.
+    static size_t pack(const std::string& directory, const std::string& path) {
+        std::vector<std::pair<std::string, std::vector<char>>> blobs;
+
+        for (const auto& item : std::filesystem::directory_iterator(directory)) {
+            if (!item.is_regular_file() || item.path().extension() != ".spv") {
+                continue;
+            }
+
+            std::ifstream input(item.path(), std::ios::binary);
+            std::vector<char> code((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            if (!isValidSpirv(code.data(), code.size())) {
+                throw std::runtime_error("failed to pack shader archive: " + item.path().string() + " is not valid SPIR-V!");
+            }
+            blobs.emplace_back(item.path().filename().string(), std::move(code));
+        }
+
+        std::vector<Entry> index(blobs.size());
+        uint64_t offset = sizeof(Header) + blobs.size() * sizeof(Entry);
+        for (size_t i = 0; i < blobs.size(); i++) {
+            offset = (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+
+            index[i].nameHash = hashBytes(blobs[i].first.data(), blobs[i].first.size());
+            index[i].contentHash = hashBytes(blobs[i].second.data(), blobs[i].second.size());
+            index[i].offset = offset;
+            index[i].size = blobs[i].second.size();
+            offset += index[i].size;
+        }
+
+        // blobs keep their offsets; only the index is ordered for the binary search.
+        std::vector<Entry> sorted = index;
+        std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return a.nameHash < b.nameHash; });
+        for (size_t i = 1; i < sorted.size(); i++) {
+            if (sorted[i].nameHash == sorted[i - 1].nameHash) {
+                throw std::runtime_error("failed to pack shader archive: two shader names hash to the same value!");
+            }
+        }
+
+        Header header{MAGIC, VERSION, static_cast<uint32_t>(sorted.size()), 0};
+
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            throw std::runtime_error("failed to open shader archive for writing!");
+        }
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(sorted.data()), sorted.size() * sizeof(Entry));
+
+        uint64_t written = sizeof(Header) + sorted.size() * sizeof(Entry);
+        for (size_t i = 0; i < blobs.size(); i++) {
+            static const char padding[BLOB_ALIGNMENT] = {};
+            output.write(padding, static_cast<std::streamsize>(index[i].offset - written));
+            output.write(blobs[i].second.data(), blobs[i].second.size());
+            written = index[i].offset + index[i].size;
+        }
+
+        if (!output) {
+            throw std::runtime_error("failed to write shader archive!");
+        }
+        return blobs.size();
+    }
+
+private:
+    MappedFile file;
+    const Entry* entries = nullptr;
+    uint32_t entryCount = 0;
+};
+
+// hands out one VkShaderModule per distinct SPIR-V blob for the lifetime of the device.
+//
+// shaders come from a packed archive when the source is a file, or from mapped .spv files when it is a directory. a
+// name is only ever read once, and two names with identical contents share a module, so pipelines that reuse shaders
+// cost neither i/o nor module creation after the first.
+class ShaderCache {
+public:
+    struct Stats {
+        uint32_t requests = 0;
+        uint32_t fileLoads = 0;
+        uint32_t archiveLoads = 0;
+        uint32_t modulesCreated = 0;
+        uint32_t duplicateContents = 0;
+    };
+
+    void init(VkDevice device, const std::string& source) {
+        this->device = device;
+        this->source = source;
+
+        if (std::filesystem::is_regular_file(source)) {
+            if (!archive.open(source)) {
+                throw std::runtime_error("failed to open shader archive " + source + "!");
+            }
+        }
+    }
+
+    void cleanup() {
+        for (const auto& entry : modulesByContent) {
+            vkDestroyShaderModule(device, entry.second.module, nullptr);
+        }
+        modulesByContent.clear();
+        modulesByName.clear();
+    }
+
+    VkShaderModule get(const std::string& name) {
+        stats.requests++;
+
+        auto named = modulesByName.find(name);
+        if (named != modulesByName.end()) {
+            return named->second;
+        }
+
+        const void* code = nullptr;
+        size_t size = 0;
+        uint64_t contentHash = 0;
+        std::unique_ptr<MappedFile> file;
+
+        if (archive.isOpen()) {
+            if (!archive.find(name, code, size, contentHash)) {
+                throw std::runtime_error("failed to find shader " + name + " in " + source + "!");
+            }
+            stats.archiveLoads++;
+        } else {
+            std::string path = (std::filesystem::path(source) / name).string();
+            file = std::make_unique<MappedFile>();
+            if (!file->open(path)) {
+                throw std::runtime_error("failed to open shader " + path + "!");
+            }
+            code = file->data();
+            size = file->size();
+            contentHash = hashBytes(code, size);
+            stats.fileLoads++;
+        }
+
+        if (!isValidSpirv(code, size)) {
+            throw std::runtime_error("shader " + name + " is not valid SPIR-V!");
+        }
+
+        // the hash only narrows the search down; two shaders are the same module only if their bytes are.
+        ContentKey key{contentHash, size};
+        auto candidates = modulesByContent.equal_range(key);
+        for (auto existing = candidates.first; existing != candidates.second; ++existing) {
+            if (std::memcmp(existing->second.code, code, size) == 0) {
+                stats.duplicateContents++;
+                modulesByName[name] = existing->second.module;
+                return existing->second.module;
+            }
+        }
+
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = size;
+        createInfo.pCode = static_cast<const uint32_t*>(code);
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module!");
+        }
+        stats.modulesCreated++;
+
+        modulesByContent.emplace(key, CachedModule{code, std::move(file), shaderModule});
+        modulesByName[name] = shaderModule;
+        return shaderModule;
+    }
+
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    void printStats() const {
+        std::cout << "shader cache: " << stats.requests << " requests, " << stats.modulesCreated << " modules, "
+                  << (archive.isOpen() ? stats.archiveLoads : stats.fileLoads) << (archive.isOpen() ? " archive" : " file")
+                  << " loads, " << stats.duplicateContents << " deduplicated" << std::endl;
+    }
+
+private:
+    using ContentKey = std::pair<uint64_t, size_t>;
+
+    // code points into the archive, or into file for a module loaded from its own file, whose mapping is kept open
+    // so a later hash match can be checked against the bytes without copying them.
+    struct CachedModule {
+        const void* code;
+        std::unique_ptr<MappedFile> file;
+        VkShaderModule module;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::string source;
+    ShaderArchive archive;
+
+    std::unordered_map<std::string, VkShaderModule> modulesByName;
+    std::multimap<ContentKey, CachedModule> modulesByContent;
+    Stats stats;
+};
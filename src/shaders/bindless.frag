@@ -0,0 +1,42 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterial;
+layout(location = 2) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    vec2 viewScale;
+    vec2 viewOffset;
+    uint textureTable;
+} frame;
+
+// the storage buffer array of the bindless set; each material is its own buffer and the instance picks one by handle.
+layout(set = 1, binding = 1) readonly buffer Material {
+    vec4 tint;
+    uint textureSlot;
+} materials[];
+
+// the table array, holding the texture streamer's residency tables: the image handle of each texture's resident mips.
+// the whole draw reads the frame's table, so the index is uniform.
+layout(set = 1, binding = 2) readonly buffer TextureTable {
+    uint handles[];
+} textureTables[];
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+const uint NOT_RESIDENT = 0xffffffffu;
+
+void main() {
+    vec4 color = vec4(fragColor, 1.0) * materials[nonuniformEXT(fragMaterial)].tint;
+    uint slot = materials[nonuniformEXT(fragMaterial)].textureSlot;
+    if (slot != NOT_RESIDENT) {
+        uint handle = textureTables[frame.textureTable].handles[slot];
+        if (handle != NOT_RESIDENT) {
+            color *= texture(textures[nonuniformEXT(handle)], fragUV);
+        }
+    }
+    outColor = color;
+}
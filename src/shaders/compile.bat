@@ -1,3 +1,13 @@
 C:/VulkanSDK/1.4.304.1/Bin/glslc.exe shader.vert -o vert.spv
+C:/VulkanSDK/1.4.304.1/Bin/glslc.exe instanced.vert -o instanced.spv
 C:/VulkanSDK/1.4.304.1/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.4.304.1/Bin/glslc.exe fallback.frag -o fallback.spv
+C:/VulkanSDK/1.4.304.1/Bin/glslc.exe bindless.frag -o bindless.spv
+C:/VulkanSDK/1.4.304.1/Bin/glslc.exe cull.comp -o cull.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.0 vert.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.0 frag.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.0 fallback.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.0 instanced.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.0 cull.spv
+C:/VulkanSDK/1.4.304.1/Bin/spirv-val.exe --target-env vulkan1.2 bindless.spv
 pause
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 450
+
+// flat grey stand-in drawn while the real fragment shader is still compiling in the background.
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 450
+
+// per frame: maps world space to clip space.
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    vec2 viewScale;
+    vec2 viewOffset;
+} frame;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// per instance
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in float inScale;
+layout(location = 4) in vec3 inInstanceColor;
+layout(location = 5) in uint inMaterial;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterial;
+layout(location = 2) out vec2 fragUV;
+
+void main() {
+    vec2 world = inPosition * inScale + inOffset;
+    gl_Position = vec4(world * frame.viewScale + frame.viewOffset, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor;
+    fragMaterial = inMaterial;
+    fragUV = inPosition + vec2(0.5);
+}
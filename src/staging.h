@@ -0,0 +1,278 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+// persistently mapped host-visible ring that feeds device-local buffers.
+//
+// uploads are copied into the ring and recorded into one transfer command buffer; nothing reaches the queue until
+// flush(), which submits everything recorded since the previous flush as a single batch. ring space is reclaimed as
+// the fence of each batch signals, so the ring is reused across loads without ever idling the queue.
+class StagingRing {
+public:
+    static constexpr VkDeviceSize DEFAULT_CAPACITY = 16ull * 1024 * 1024;
+
+    void init(VkDevice device, GpuAllocator& allocator, uint32_t queueFamily, VkQueue queue, VkDeviceSize capacity = DEFAULT_CAPACITY) {
+        this->device = device;
+        this->allocator = &allocator;
+        this->queue = queue;
+        this->capacity = capacity;
+
+        allocator.createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               buffer, allocation);
+        mapped = static_cast<char*>(allocation.mapped);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging command pool!");
+        }
+    }
+
+    void cleanup() {
+        waitIdle();
+
+        for (auto& batch : freeBatches) {
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+        freeBatches.clear();
+
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        allocator->destroyBuffer(buffer, allocation);
+    }
+
+    // copies data into the ring and records a copy into dst. large uploads are split so no chunk can starve the ring.
+    void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+        const char* bytes = static_cast<const char*>(data);
+        VkDeviceSize maxChunk = capacity / 4;
+
+        while (size > 0) {
+            VkDeviceSize chunk = std::min(size, maxChunk);
+            VkDeviceSize offset = reserve(chunk, 16);
+            std::memcpy(mapped + offset, bytes, chunk);
+
+            VkBufferCopy copyRegion{};
+            copyRegion.srcOffset = offset;
+            copyRegion.dstOffset = dstOffset;
+            copyRegion.size = chunk;
+            vkCmdCopyBuffer(recordingCommandBuffer(), buffer, dst, 1, &copyRegion);
+
+            bytes += chunk;
+            dstOffset += chunk;
+            size -= chunk;
+        }
+    }
+
+    // reserves ring space for callers that record their own copy (e.g. buffer-to-image). the returned pointer is only valid
+    // until the next flush.
+    void* allocate(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& srcBuffer, VkDeviceSize& srcOffset) {
+        if (size > capacity / 2) {
+            throw std::runtime_error("staging allocation is larger than half the ring!");
+        }
+
+        srcOffset = reserve(size, alignment);
+        srcBuffer = buffer;
+        return mapped + srcOffset;
+    }
+
+    VkCommandBuffer recordingCommandBuffer() {
+        if (recording.commandBuffer == VK_NULL_HANDLE) {
+            beginBatch();
+        }
+        return recording.commandBuffer;
+    }
+
+    // submits every upload recorded since the last flush as one batch. returns false if there was nothing to submit.
+    // if signalSemaphore is a timeline semaphore it is set to signalValue once the batch has finished.
+    bool flush(VkSemaphore signalSemaphore = VK_NULL_HANDLE, uint64_t signalValue = 0) {
+        if (recording.commandBuffer == VK_NULL_HANDLE) {
+            return false;
+        }
+
+        // make the copies visible to everything that runs after this batch in submission order, on this queue.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(recording.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+
+        if (vkEndCommandBuffer(recording.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record staging command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &recording.commandBuffer;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        if (signalSemaphore != VK_NULL_HANDLE) {
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &signalSemaphore;
+        }
+
+        if (vkQueueSubmit(queue, 1, &submitInfo, recording.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit staging command buffer!");
+        }
+
+        recording.ringEnd = head;
+        inFlight.push_back(recording);
+        recording = Batch{};
+        submittedBatches++;
+        return true;
+    }
+
+    void waitIdle() {
+        flush();
+        while (!inFlight.empty()) {
+            retireOldest(true);
+        }
+    }
+
+    uint64_t batchCount() const {
+        return submittedBatches;
+    }
+
+    // batches are numbered from 1 in submission order, and they finish in that order. the batch batchCount() returned
+    // right after its flush() has finished once this reaches its number. never waits.
+    uint64_t completedBatchCount() {
+        retireCompleted();
+        return retiredBatches;
+    }
+
+    // whether size bytes could be reserved right now without waiting for a batch to finish, so callers that must not
+    // block can put their upload off instead.
+    bool hasRoom(VkDeviceSize size, VkDeviceSize alignment) {
+        retireCompleted();
+        return place(size, alignment) + size - tail <= capacity;
+    }
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // ring position (in total bytes ever reserved) at the end of this batch; reaching it frees everything before it.
+        uint64_t ringEnd = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    GpuAllocator* allocator = nullptr;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+    char* mapped = nullptr;
+    VkDeviceSize capacity = 0;
+
+    // monotonically increasing byte counters; head - tail is the space currently owned by recorded or in-flight batches.
+    uint64_t head = 0;
+    uint64_t tail = 0;
+
+    Batch recording;
+    std::deque<Batch> inFlight;
+    std::vector<Batch> freeBatches;
+    uint64_t submittedBatches = 0;
+    uint64_t retiredBatches = 0;
+
+    // where an allocation of size would start, in total bytes ever reserved.
+    uint64_t place(VkDeviceSize size, VkDeviceSize alignment) const {
+        uint64_t start = (head + alignment - 1) / alignment * alignment;
+        // an allocation never straddles the end of the ring; skip to the start instead.
+        if (start % capacity + size > capacity) {
+            start = (start / capacity + 1) * capacity;
+        }
+        return start;
+    }
+
+    VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment) {
+        while (true) {
+            retireCompleted();
+
+            uint64_t start = place(size, alignment);
+            if (start + size - tail <= capacity) {
+                head = start + size;
+                return start % capacity;
+            }
+
+            // out of space: push what we have so far and wait for the oldest batch to free its range.
+            if (inFlight.empty()) {
+                flush();
+            }
+            if (inFlight.empty()) {
+                throw std::runtime_error("staging ring is too small for this upload!");
+            }
+            retireOldest(true);
+        }
+    }
+
+    void retireCompleted() {
+        while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+            retireOldest(false);
+        }
+    }
+
+    void retireOldest(bool wait) {
+        Batch batch = inFlight.front();
+        inFlight.pop_front();
+
+        if (wait) {
+            vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        }
+
+        tail = batch.ringEnd;
+        freeBatches.push_back(batch);
+        retiredBatches++;
+    }
+
+    void beginBatch() {
+        if (!freeBatches.empty()) {
+            recording = freeBatches.back();
+            freeBatches.pop_back();
+            vkResetFences(device, 1, &recording.fence);
+            vkResetCommandBuffer(recording.commandBuffer, 0);
+        } else {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device, &allocInfo, &recording.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate staging command buffer!");
+            }
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+            if (vkCreateFence(device, &fenceInfo, nullptr, &recording.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create staging fence!");
+            }
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(recording.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording staging command buffer!");
+        }
+    }
+};
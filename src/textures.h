@@ -0,0 +1,809 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "allocator.h"
+#include "bindless.h"
+#include "device_caps.h"
+#include "shader_cache.h"
+#include "staging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// texel blocks of a format as they are laid out in a file and in a buffer-to-image copy. uncompressed formats are one
+// texel per block.
+struct TextureFormatInfo {
+    uint32_t blockWidth = 1;
+    uint32_t blockHeight = 1;
+    uint32_t blockBytes = 0;
+
+    bool compressed() const {
+        return blockWidth > 1;
+    }
+};
+
+// the formats the texture streamer takes: 8-bit rgba/bgra and the BCn block formats.
+inline bool textureFormatInfo(VkFormat format, TextureFormatInfo& info) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        info = {1, 1, 4};
+        return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        info = {4, 4, 8};
+        return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        info = {4, 4, 16};
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline uint32_t fullMipCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+// one mip level of a texture file, as an offset into the mapping.
+struct TextureLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t offset = 0;
+};
+
+// a DDS or KTX2 file mapped into memory and parsed in place. levels[0] is the full-size image. nothing is read from
+// disk until a level is staged, so opening even a large set of textures costs little more than the headers.
+struct TextureSource {
+    std::string name;
+    std::unique_ptr<MappedFile> file;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    TextureFormatInfo info;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // the levels stored in the file. an uncompressed file with only the first one gets the rest generated on the GPU.
+    std::vector<TextureLevel> levels;
+
+    uint32_t blockRows(uint32_t level) const {
+        return (levelHeight(level) + info.blockHeight - 1) / info.blockHeight;
+    }
+
+    VkDeviceSize rowBytes(uint32_t level) const {
+        return VkDeviceSize((levelWidth(level) + info.blockWidth - 1) / info.blockWidth) * info.blockBytes;
+    }
+
+    VkDeviceSize levelBytes(uint32_t level) const {
+        return rowBytes(level) * blockRows(level);
+    }
+
+    uint32_t levelWidth(uint32_t level) const {
+        return std::max(1u, width >> level);
+    }
+
+    uint32_t levelHeight(uint32_t level) const {
+        return std::max(1u, height >> level);
+    }
+
+    const char* levelData(uint32_t level) const {
+        return file->data() + levels[level].offset;
+    }
+
+    bool generatesMips() const {
+        return levels.size() == 1 && !info.compressed() && fullMipCount(width, height) > 1;
+    }
+};
+
+namespace texture_files {
+
+inline uint32_t readU32(const char* bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+inline uint64_t readU64(const char* bytes) {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+inline uint32_t fourCC(const char (&code)[5]) {
+    return readU32(code);
+}
+
+inline VkFormat dxgiFormat(uint32_t dxgi) {
+    switch (dxgi) {
+    case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+    case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+    case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+    case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+    case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+// no device makes 2d images this large, and below it a level's size cannot overflow 64 bits.
+const uint32_t MAX_TEXTURE_DIMENSION = 65536;
+
+// levelWidth() shifts by the level and levelBytes() multiplies the dimensions, so both have to be checked before a
+// level of the file is looked at.
+inline bool checkDimensions(const TextureSource& source, uint32_t levelCount, std::string& error) {
+    if (source.width == 0 || source.height == 0 || source.width > MAX_TEXTURE_DIMENSION || source.height > MAX_TEXTURE_DIMENSION ||
+        levelCount > fullMipCount(source.width, source.height)) {
+        error = "bad texture dimensions or level count";
+        return false;
+    }
+    return true;
+}
+
+// DDS: a 124-byte header after the magic, an optional DX10 extension, then every level back to back, largest first.
+inline bool parseDds(TextureSource& source, std::string& error) {
+    const char* data = source.file->data();
+    size_t size = source.file->size();
+    if (size < 128 || readU32(data + 4) != 124) {
+        error = "truncated DDS header";
+        return false;
+    }
+
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+    uint32_t flags = readU32(data + 8);
+    source.height = readU32(data + 12);
+    source.width = readU32(data + 16);
+    uint32_t mipCount = (flags & DDSD_MIPMAPCOUNT) ? std::max(1u, readU32(data + 28)) : 1;
+    uint32_t pixelFlags = readU32(data + 80);
+    uint32_t code = readU32(data + 84);
+    uint32_t caps2 = readU32(data + 112);
+    if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) {
+        error = "cube maps and volume textures are not supported";
+        return false;
+    }
+
+    size_t offset = 128;
+    if (pixelFlags & DDPF_FOURCC) {
+        if (code == fourCC("DX10")) {
+            if (size < 148) {
+                error = "truncated DX10 header";
+                return false;
+            }
+            if (readU32(data + 140) > 1) {
+                error = "texture arrays are not supported";
+                return false;
+            }
+            source.format = dxgiFormat(readU32(data + 128));
+            offset = 148;
+        } else if (code == fourCC("DXT1")) {
+            source.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        } else if (code == fourCC("DXT2") || code == fourCC("DXT3")) {
+            source.format = VK_FORMAT_BC2_UNORM_BLOCK;
+        } else if (code == fourCC("DXT4") || code == fourCC("DXT5")) {
+            source.format = VK_FORMAT_BC3_UNORM_BLOCK;
+        } else if (code == fourCC("ATI1") || code == fourCC("BC4U")) {
+            source.format = VK_FORMAT_BC4_UNORM_BLOCK;
+        } else if (code == fourCC("ATI2") || code == fourCC("BC5U")) {
+            source.format = VK_FORMAT_BC5_UNORM_BLOCK;
+        }
+    } else if ((pixelFlags & DDPF_RGB) && readU32(data + 88) == 32) {
+        uint32_t redMask = readU32(data + 92);
+        if (redMask == 0x000000ff) {
+            source.format = VK_FORMAT_R8G8B8A8_UNORM;
+        } else if (redMask == 0x00ff0000) {
+            source.format = VK_FORMAT_B8G8R8A8_UNORM;
+        }
+    }
+    if (!textureFormatInfo(source.format, source.info)) {
+        error = "unsupported DDS pixel format";
+        return false;
+    }
+    if (!checkDimensions(source, mipCount, error)) {
+        return false;
+    }
+
+    for (uint32_t level = 0; level < mipCount; level++) {
+        source.levels.push_back({source.levelWidth(level), source.levelHeight(level), offset});
+        offset += source.levelBytes(level);
+    }
+    return true;
+}
+
+// KTX2: a fixed header naming the vulkan format directly, then an index giving each level's offset and length.
+inline bool parseKtx2(TextureSource& source, std::string& error) {
+    const char* data = source.file->data();
+    size_t size = source.file->size();
+    if (size < 80) {
+        error = "truncated KTX2 header";
+        return false;
+    }
+
+    source.format = static_cast<VkFormat>(readU32(data + 12));
+    source.width = readU32(data + 20);
+    source.height = readU32(data + 24);
+    uint32_t depth = readU32(data + 28);
+    uint32_t layers = readU32(data + 32);
+    uint32_t faces = readU32(data + 36);
+    // a level count of 0 asks the loader to generate the mip chain.
+    uint32_t levelCount = std::max(1u, readU32(data + 40));
+    uint32_t supercompression = readU32(data + 44);
+    if (depth > 1 || layers > 1 || faces != 1) {
+        error = "only single 2d images are supported";
+        return false;
+    }
+    if (supercompression != 0) {
+        error = "supercompressed KTX2 is not supported";
+        return false;
+    }
+    if (!textureFormatInfo(source.format, source.info)) {
+        error = "unsupported KTX2 format";
+        return false;
+    }
+    if (!checkDimensions(source, levelCount, error)) {
+        return false;
+    }
+    if (size < 80 + size_t(levelCount) * 24) {
+        error = "truncated KTX2 level index";
+        return false;
+    }
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const char* entry = data + 80 + level * 24;
+        uint64_t offset = readU64(entry);
+        uint64_t length = readU64(entry + 8);
+        if (length < source.levelBytes(level)) {
+            error = "KTX2 level is smaller than its format and size need";
+            return false;
+        }
+        source.levels.push_back({source.levelWidth(level), source.levelHeight(level), static_cast<size_t>(offset)});
+    }
+    return true;
+}
+
+} // namespace texture_files
+
+// maps path and parses its header. on failure returns false with a reason in error.
+inline bool loadTextureSource(const std::string& path, TextureSource& source, std::string& error) {
+    static const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    source = TextureSource{};
+    source.name = path;
+    source.file = std::make_unique<MappedFile>();
+    if (!source.file->open(path)) {
+        error = "failed to map the file";
+        return false;
+    }
+
+    const char* data = source.file->data();
+    size_t size = source.file->size();
+    bool parsed = false;
+    if (size >= 4 && std::memcmp(data, "DDS ", 4) == 0) {
+        parsed = texture_files::parseDds(source, error);
+    } else if (size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+        parsed = texture_files::parseKtx2(source, error);
+    } else {
+        error = "not a DDS or KTX2 file";
+    }
+    if (!parsed) {
+        return false;
+    }
+
+    for (uint32_t level = 0; level < source.levels.size(); level++) {
+        size_t offset = source.levels[level].offset;
+        if (offset > size || source.levelBytes(level) > size - offset) {
+            error = "texture data runs past the end of the file";
+            return false;
+        }
+    }
+    return true;
+}
+
+struct TextureStreamSettings {
+    // the staging ring every texture upload goes through. streaming never holds more host memory than this.
+    VkDeviceSize stagingCapacity = 8ull * 1024 * 1024;
+    // bytes staged per frame; whatever is left waits for later frames.
+    VkDeviceSize frameBudget = 2ull * 1024 * 1024;
+    // mips no larger than this on their longer side are uploaded as soon as a texture is added, so every texture has
+    // something to draw long before its full chain is resident.
+    uint32_t tailSize = 64;
+};
+
+// streams the mip levels of many textures into device-local images on the graphics queue, smallest first.
+//
+// every texture gets its whole image up front, but only the levels from residentLevel down are ever sampled: the
+// image view starts at that level, so a level becomes visible by swapping the view once its upload has finished. the
+// bindless descriptor of a live view is never rewritten; each swap adds a new one and releases the old. shaders find a
+// texture's current descriptor through a residency table, one slice per frame in flight, written in beginFrame().
+//
+// which levels stream in is driven by request(), the on-screen size the renderer needs each texture at this frame, and
+// capped by a per-frame byte budget. levels are copied in bands of block rows, so a level larger than the budget
+// spreads over several frames, and nothing is staged unless the ring has room, so the frame loop never waits on it.
+class TextureStreamer {
+public:
+    static constexpr uint32_t NOT_RESIDENT = UINT32_MAX;
+
+    void init(VkDevice device, const DeviceCapabilities& caps, GpuAllocator& allocator, BindlessHeap& heap, uint32_t queueFamily,
+              VkQueue queue, uint32_t framesInFlight, uint32_t capacity, bool compressionBC, const TextureStreamSettings& settings) {
+        this->device = device;
+        this->physicalDevice = caps.physicalDevice;
+        this->maxDimension = caps.properties.limits.maxImageDimension2D;
+        this->allocator = &allocator;
+        this->heap = &heap;
+        this->capacity = capacity;
+        this->compressionBC = compressionBC;
+        this->settings = settings;
+
+        staging.init(device, allocator, queueFamily, queue, settings.stagingCapacity);
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+
+        VkDeviceSize alignment = std::max<VkDeviceSize>(4, caps.properties.limits.minStorageBufferOffsetAlignment);
+        tableSliceSize = (VkDeviceSize(capacity) * sizeof(uint32_t) + alignment - 1) / alignment * alignment;
+
+        allocator.createBuffer(tableSliceSize * framesInFlight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                               tableBuffer, tableMemory);
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+            tableHandles.push_back(heap.addTable(tableBuffer, tableSliceSize * i, tableSliceSize));
+        }
+    }
+
+    void cleanup() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+
+        staging.cleanup();
+        for (const auto& retired : retiredViews) {
+            vkDestroyImageView(device, retired.view, nullptr);
+        }
+        retiredViews.clear();
+        for (auto& texture : textures) {
+            if (texture.view != VK_NULL_HANDLE) {
+                vkDestroyImageView(device, texture.view, nullptr);
+            }
+            allocator->destroyImage(texture.image, texture.memory);
+        }
+        textures.clear();
+        allocator->destroyBuffer(tableBuffer, tableMemory);
+        vkDestroySampler(device, sampler, nullptr);
+        device = VK_NULL_HANDLE;
+    }
+
+    bool active() const {
+        return device != VK_NULL_HANDLE;
+    }
+
+    // whether the device can make an image that large and sample its format, and blit it when its mips are to be
+    // generated.
+    bool supports(const TextureSource& source) const {
+        if (source.width > maxDimension || source.height > maxDimension) {
+            return false;
+        }
+        if (source.info.compressed() && !compressionBC) {
+            return false;
+        }
+
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, source.format, &properties);
+        VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        if (source.generatesMips()) {
+            needed |= VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        }
+        return (properties.optimalTilingFeatures & needed) == needed;
+    }
+
+    // creates the texture's image and stages its mip tail. returns the slot the residency table keeps it at.
+    uint32_t add(TextureSource&& source) {
+        if (textures.size() == capacity) {
+            throw std::runtime_error("texture streamer is full!");
+        }
+        if (source.width > maxDimension || source.height > maxDimension) {
+            throw std::runtime_error("texture is larger than the device allows!");
+        }
+
+        Texture texture;
+        texture.levelCount = source.generatesMips() ? fullMipCount(source.width, source.height) : static_cast<uint32_t>(source.levels.size());
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = source.format;
+        imageInfo.extent = {source.width, source.height, 1};
+        imageInfo.mipLevels = texture.levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (source.generatesMips()) {
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        allocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory);
+
+        texture.residentLevel = texture.levelCount;
+        texture.nextLevel = source.generatesMips() ? 0 : texture.levelCount - 1;
+        texture.wantedLevel = texture.levelCount;
+        texture.source = std::move(source);
+        textures.push_back(std::move(texture));
+
+        // the tail goes in now, whatever the frame budget.
+        Texture& added = textures.back();
+        while (!added.streamed() && !added.source.generatesMips() &&
+               std::max(added.source.levelWidth(added.nextLevel), added.source.levelHeight(added.nextLevel)) <= settings.tailSize) {
+            streamBand(added, VK_WHOLE_SIZE, true);
+        }
+        return static_cast<uint32_t>(textures.size() - 1);
+    }
+
+    // the renderer needs the texture in slot at about pixelSize texels across this frame. only levels down to the one
+    // that size calls for are streamed; the smallest request of the frame counts.
+    void request(uint32_t slot, float pixelSize) {
+        Texture& texture = textures[slot];
+        float texels = static_cast<float>(std::max(texture.source.width, texture.source.height));
+        uint32_t level = 0;
+        if (pixelSize > 0.0f && texels > pixelSize) {
+            level = static_cast<uint32_t>(std::floor(std::log2(texels / pixelSize)));
+        }
+        texture.wantedLevel = std::min({texture.wantedLevel, level, texture.levelCount - 1});
+    }
+
+    // swaps in the views of levels whose uploads have finished, destroys views no running frame can still use and writes
+    // frameSlot's residency table. call after BindlessHeap::beginFrame() for the same slot, which must have been waited for.
+    void beginFrame(uint32_t frameSlot, uint64_t frameNumber, uint64_t completedFrameCount) {
+        while (!retiredViews.empty() && retiredViews.front().retireFrame <= completedFrameCount) {
+            vkDestroyImageView(device, retiredViews.front().view, nullptr);
+            retiredViews.pop_front();
+        }
+
+        uint64_t completedBatches = staging.completedBatchCount();
+        uint32_t* table = reinterpret_cast<uint32_t*>(static_cast<char*>(tableMemory.mapped) + tableSliceSize * frameSlot);
+        for (size_t i = 0; i < textures.size(); i++) {
+            Texture& texture = textures[i];
+            if (texture.pendingBatch != 0 && texture.pendingBatch <= completedBatches) {
+                makeResident(texture, frameNumber);
+            }
+            table[i] = texture.handle.valid() ? texture.handle.index : NOT_RESIDENT;
+            // requests are per frame.
+            texture.wantedLevel = texture.levelCount;
+        }
+        allocator->flush(tableMemory, tableSliceSize * frameSlot, sizeof(uint32_t) * textures.size());
+    }
+
+    // stages up to the frame budget of the levels requested since beginFrame() and submits them. the textures furthest
+    // from the detail they were asked for go first, one level each, so every texture sharpens at a similar pace.
+    void stream() {
+        candidates.clear();
+        for (uint32_t i = 0; i < textures.size(); i++) {
+            const Texture& texture = textures[i];
+            if (!texture.streamed() && (texture.nextLevel >= texture.wantedLevel || texture.source.generatesMips())) {
+                candidates.push_back(i);
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+            return textures[a].deficit() > textures[b].deficit();
+        });
+
+        VkDeviceSize budget = settings.frameBudget;
+        bool ringFull = false;
+        for (size_t i = 0; i < candidates.size() && budget > 0 && !ringFull; i++) {
+            Texture& texture = textures[candidates[i]];
+            uint32_t level = texture.nextLevel;
+            while (budget > 0 && !texture.streamed() && texture.nextLevel == level) {
+                VkDeviceSize staged = streamBand(texture, budget, false);
+                if (staged == 0) {
+                    ringFull = true;
+                    break;
+                }
+                budget -= std::min(budget, staged);
+            }
+        }
+
+        flush();
+    }
+
+    // submits everything staged so far. the textures it completes become visible in the first beginFrame() after it lands.
+    void flush() {
+        staging.flush();
+        // a full ring may already have submitted some of them on its own; the last batch covers those too.
+        uint64_t batch = staging.batchCount();
+        for (uint32_t index : unsubmitted) {
+            textures[index].pendingBatch = batch;
+        }
+        unsubmitted.clear();
+    }
+
+    // the last stream() left nothing it was asked for unstaged, and everything staged has become resident.
+    bool settled() const {
+        if (!candidates.empty() || !unsubmitted.empty()) {
+            return false;
+        }
+        for (const auto& texture : textures) {
+            if (texture.pendingBatch != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    BindlessHandle tableHandle(uint32_t frameSlot) const {
+        return tableHandles[frameSlot];
+    }
+
+    uint32_t textureCount() const {
+        return static_cast<uint32_t>(textures.size());
+    }
+
+    void printStats() const {
+        uint32_t complete = 0;
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize totalBytes = 0;
+        for (const auto& texture : textures) {
+            if (texture.residentLevel == 0) {
+                complete++;
+            }
+            for (uint32_t level = 0; level < texture.levelCount; level++) {
+                VkDeviceSize bytes = texture.source.levelBytes(level);
+                totalBytes += bytes;
+                if (level >= texture.residentLevel) {
+                    residentBytes += bytes;
+                }
+            }
+        }
+        std::cout << "textures: " << textures.size() << " (" << complete << " fully resident), " << residentBytes / 1024 << " of "
+                  << totalBytes / 1024 << " KiB resident, " << stagedBytes / 1024 << " KiB staged in " << staging.batchCount()
+                  << " batches, " << generatedChains << " mip chains generated, " << viewSwaps << " view swaps" << std::endl;
+    }
+
+private:
+    struct Texture {
+        TextureSource source;
+        VkImage image = VK_NULL_HANDLE;
+        GpuAllocation memory;
+        uint32_t levelCount = 0;
+
+        // the sampled view starts at residentLevel; levelCount while nothing is resident yet.
+        VkImageView view = VK_NULL_HANDLE;
+        BindlessHandle handle;
+        uint32_t residentLevel = 0;
+
+        // the level being staged and the block row it continues from. streaming runs from the smallest level up and
+        // stops once level 0 has been staged.
+        uint32_t nextLevel = 0;
+        uint32_t nextRow = 0;
+        bool finished = false;
+
+        // the lowest level staged in full, and the staging batch that has to finish before it may be sampled.
+        uint32_t stagedLevel = UINT32_MAX;
+        uint64_t pendingBatch = 0;
+
+        // the lowest level requested this frame.
+        uint32_t wantedLevel = 0;
+
+        bool streamed() const {
+            return finished;
+        }
+
+        uint32_t deficit() const {
+            return source.generatesMips() ? levelCount : nextLevel + 1 - std::min(wantedLevel, nextLevel + 1);
+        }
+    };
+
+    struct RetiredView {
+        uint64_t retireFrame;
+        VkImageView view;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    uint32_t maxDimension = 0;
+    GpuAllocator* allocator = nullptr;
+    BindlessHeap* heap = nullptr;
+    uint32_t capacity = 0;
+    bool compressionBC = false;
+    TextureStreamSettings settings;
+
+    StagingRing staging;
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::vector<Texture> textures;
+    // staged levels waiting for the flush that gives them a batch to wait on.
+    std::vector<uint32_t> unsubmitted;
+    std::vector<uint32_t> candidates;
+    std::deque<RetiredView> retiredViews;
+
+    VkBuffer tableBuffer = VK_NULL_HANDLE;
+    GpuAllocation tableMemory;
+    VkDeviceSize tableSliceSize = 0;
+    std::vector<BindlessHandle> tableHandles;
+
+    VkDeviceSize stagedBytes = 0;
+    uint64_t generatedChains = 0;
+    uint64_t viewSwaps = 0;
+
+    void barrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout,
+                 VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = srcAccess;
+        imageBarrier.dstAccessMask = dstAccess;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+    }
+
+    // stages the next band of block rows of texture.nextLevel, at most maxBytes of them but always at least one row.
+    // returns the bytes staged: 0 when the ring has no room this frame, unless wait allows waiting for it.
+    VkDeviceSize streamBand(Texture& texture, VkDeviceSize maxBytes, bool wait) {
+        const TextureSource& source = texture.source;
+        uint32_t level = texture.nextLevel;
+        VkDeviceSize rowBytes = source.rowBytes(level);
+        uint32_t rows = source.blockRows(level) - texture.nextRow;
+        VkDeviceSize ringLimit = std::max(rowBytes, settings.stagingCapacity / 4);
+        rows = static_cast<uint32_t>(std::min<VkDeviceSize>(rows, std::max(rowBytes, std::min(maxBytes, ringLimit)) / rowBytes));
+        VkDeviceSize bandSize = rowBytes * rows;
+        if (!wait && !staging.hasRoom(bandSize, 16)) {
+            return 0;
+        }
+
+        if (texture.nextRow == 0) {
+            uint32_t levels = source.generatesMips() ? texture.levelCount : 1;
+            barrier(staging.recordingCommandBuffer(), texture.image, level, levels, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+
+        VkBuffer srcBuffer;
+        VkDeviceSize srcOffset;
+        void* mapped = staging.allocate(bandSize, 16, srcBuffer, srcOffset);
+        std::memcpy(mapped, source.levelData(level) + rowBytes * texture.nextRow, bandSize);
+
+        uint32_t top = texture.nextRow * source.info.blockHeight;
+        VkBufferImageCopy region{};
+        region.bufferOffset = srcOffset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        region.imageOffset = {0, static_cast<int32_t>(top), 0};
+        region.imageExtent = {source.levelWidth(level), std::min(rows * source.info.blockHeight, source.levelHeight(level) - top), 1};
+        // allocate() may have flushed the previous command buffer to make room, so fetch it again.
+        vkCmdCopyBufferToImage(staging.recordingCommandBuffer(), srcBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1, &region);
+        stagedBytes += bandSize;
+
+        texture.nextRow += rows;
+        if (texture.nextRow == source.blockRows(level)) {
+            finishLevel(texture);
+        }
+        return bandSize;
+    }
+
+    void finishLevel(Texture& texture) {
+        VkCommandBuffer commandBuffer = staging.recordingCommandBuffer();
+        uint32_t level = texture.nextLevel;
+        if (texture.source.generatesMips()) {
+            generateMips(commandBuffer, texture);
+        } else {
+            barrier(commandBuffer, texture.image, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+
+        texture.stagedLevel = level;
+        unsubmitted.push_back(static_cast<uint32_t>(&texture - textures.data()));
+        texture.nextRow = 0;
+        if (level == 0) {
+            texture.finished = true;
+        } else {
+            texture.nextLevel = level - 1;
+        }
+    }
+
+    // fills every level below the first by blitting down from the one above it, then leaves them all shader readable.
+    void generateMips(VkCommandBuffer commandBuffer, Texture& texture) {
+        for (uint32_t level = 1; level < texture.levelCount; level++) {
+            barrier(commandBuffer, texture.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            VkImageBlit blit{};
+            blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+            blit.srcOffsets[1] = {static_cast<int32_t>(texture.source.levelWidth(level - 1)),
+                                  static_cast<int32_t>(texture.source.levelHeight(level - 1)), 1};
+            blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            blit.dstOffsets[1] = {static_cast<int32_t>(texture.source.levelWidth(level)),
+                                  static_cast<int32_t>(texture.source.levelHeight(level)), 1};
+            vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+            barrier(commandBuffer, texture.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+        barrier(commandBuffer, texture.image, texture.levelCount - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        generatedChains++;
+    }
+
+    // the staged levels have landed: a new view starting at the lowest of them replaces the old one, which is retired
+    // with the frame being recorded.
+    void makeResident(Texture& texture, uint64_t frameNumber) {
+        texture.pendingBatch = 0;
+        if (texture.stagedLevel >= texture.residentLevel) {
+            return;
+        }
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = texture.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = texture.source.format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, texture.stagedLevel, texture.levelCount - texture.stagedLevel, 0, 1};
+
+        VkImageView view;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture view!");
+        }
+
+        if (texture.view != VK_NULL_HANDLE) {
+            heap->releaseImage(texture.handle);
+            retiredViews.push_back({frameNumber, texture.view});
+            viewSwaps++;
+        }
+        texture.view = view;
+        texture.handle = heap->addImage(view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        texture.residentLevel = texture.stagedLevel;
+    }
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "staging.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+// streams buffers and images to the device on a transfer queue while the graphics queue keeps rendering.
+//
+// uploads go through a StagingRing bound to the transfer queue and are submitted in batches by submit(), which signals
+// a timeline semaphore with the batch's value. when the transfer queue belongs to another family, every destination
+// is released by the transfer queue and has to be acquired by the graphics queue with cmdAcquire() before first use;
+// the graphics submit that contains the acquire must also wait on semaphore() for the returned value. nothing on
+// either side ever waits for the queue to go idle.
+class AsyncUploader {
+public:
+    // stage at which the graphics side waits for and acquires uploads. acquires are only recorded for batches that have
+    // already completed, so waiting on every stage costs nothing and keeps layout transitions simple.
+    static constexpr VkPipelineStageFlags ACQUIRE_STAGE = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    void init(VkDevice device, GpuAllocator& allocator, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily,
+              VkDeviceSize capacity = StagingRing::DEFAULT_CAPACITY) {
+        this->device = device;
+        this->transferFamily = transferFamily;
+        this->graphicsFamily = graphicsFamily;
+        this->capacity = capacity;
+
+        staging.init(device, allocator, transferFamily, transferQueue, capacity);
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload timeline semaphore!");
+        }
+    }
+
+    void cleanup() {
+        staging.cleanup();
+        vkDestroySemaphore(device, timeline, nullptr);
+        pending = Batch{};
+        submitted.clear();
+    }
+
+    bool transfersOwnership() const {
+        return transferFamily != graphicsFamily;
+    }
+
+    VkSemaphore semaphore() const {
+        return timeline;
+    }
+
+    // the value submit() will signal for everything uploaded since the last submit.
+    uint64_t nextValue() const {
+        return submittedValue + 1;
+    }
+
+    uint64_t completedValue() const {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(device, timeline, &value);
+        return value;
+    }
+
+    bool isComplete(uint64_t value) const {
+        return completedValue() >= value;
+    }
+
+    void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+        staging.uploadBuffer(dst, dstOffset, data, size);
+
+        if (transfersOwnership()) {
+            // the release half: the copy's writes are made available before the buffer changes hands.
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = dst;
+            barrier.offset = dstOffset;
+            barrier.size = size;
+            pending.bufferBarriers.push_back(barrier);
+        }
+    }
+
+    // uploads the first mip level of a 2d color image, tightly packed at texelSize bytes per texel, and leaves it in
+    // finalLayout. the image is copied in bands of rows so it may be larger than the ring.
+    void uploadImage(VkImage dst, uint32_t width, uint32_t height, uint32_t texelSize, const void* data, VkImageLayout finalLayout) {
+        VkCommandBuffer commandBuffer = staging.recordingCommandBuffer();
+
+        VkImageMemoryBarrier toTransfer{};
+        toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransfer.srcAccessMask = 0;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.image = dst;
+        toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &toTransfer);
+
+        const char* bytes = static_cast<const char*>(data);
+        VkDeviceSize rowSize = VkDeviceSize(width) * texelSize;
+        uint32_t rowsPerBand = static_cast<uint32_t>(std::max<VkDeviceSize>(1, (capacity / 4) / rowSize));
+
+        for (uint32_t row = 0; row < height; row += rowsPerBand) {
+            uint32_t rows = std::min(rowsPerBand, height - row);
+            VkDeviceSize bandSize = rowSize * rows;
+
+            VkBuffer srcBuffer;
+            VkDeviceSize srcOffset;
+            void* mapped = staging.allocate(bandSize, 16, srcBuffer, srcOffset);
+            std::memcpy(mapped, bytes + rowSize * row, bandSize);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = srcOffset;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageOffset = {0, static_cast<int32_t>(row), 0};
+            region.imageExtent = {width, rows, 1};
+
+            // allocate() may have flushed the previous command buffer to make room, so fetch it again.
+            vkCmdCopyBufferToImage(staging.recordingCommandBuffer(), srcBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+
+        // with ownership transfer this is the release half of the transition, otherwise the whole transition.
+        VkImageMemoryBarrier release{};
+        release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = transfersOwnership() ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+        release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        release.newLayout = finalLayout;
+        release.srcQueueFamilyIndex = transfersOwnership() ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        release.dstQueueFamilyIndex = transfersOwnership() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        release.image = dst;
+        release.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        pending.imageBarriers.push_back(release);
+    }
+
+    // submits everything uploaded since the last call and returns the timeline value that marks its completion, or the
+    // last submitted value if there was nothing new.
+    uint64_t submit() {
+        if (pending.bufferBarriers.empty() && pending.imageBarriers.empty()) {
+            if (staging.flush(timeline, submittedValue + 1)) {
+                submittedValue++;
+            }
+            return submittedValue;
+        }
+
+        VkPipelineStageFlags dstStage = transfersOwnership() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        vkCmdPipelineBarrier(staging.recordingCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(pending.bufferBarriers.size()), pending.bufferBarriers.data(),
+                             static_cast<uint32_t>(pending.imageBarriers.size()), pending.imageBarriers.data());
+
+        submittedValue++;
+        staging.flush(timeline, submittedValue);
+
+        pending.value = submittedValue;
+        if (transfersOwnership()) {
+            submitted.push_back(pending);
+        }
+        pending = Batch{};
+
+        return submittedValue;
+    }
+
+    // records the acquire half of every ownership transfer whose batch is at or below upToValue. returns the value the
+    // submit containing commandBuffer must wait on semaphore() for at ACQUIRE_STAGE, or 0 if nothing new was picked up.
+    // pass completedValue() to pick up only what has already landed and never stall the graphics queue.
+    uint64_t cmdAcquire(VkCommandBuffer commandBuffer, uint64_t upToValue) {
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+
+        while (!submitted.empty() && submitted.front().value <= upToValue) {
+            Batch& batch = submitted.front();
+
+            for (VkBufferMemoryBarrier barrier : batch.bufferBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                bufferBarriers.push_back(barrier);
+            }
+            for (VkImageMemoryBarrier barrier : batch.imageBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                imageBarriers.push_back(barrier);
+            }
+
+            submitted.pop_front();
+        }
+
+        if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+            vkCmdPipelineBarrier(commandBuffer, ACQUIRE_STAGE, ACQUIRE_STAGE, 0,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                                 static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+
+        uint64_t value = std::min(upToValue, submittedValue);
+        if (value <= acquiredValue) {
+            return 0;
+        }
+        acquiredValue = value;
+        return value;
+    }
+
+    // every upload at or below this value may be used by the graphics queue.
+    uint64_t usableValue() const {
+        return acquiredValue;
+    }
+
+    // blocks until every submitted upload has finished. only meant for shutdown and tools, never for the frame loop.
+    void waitIdle() {
+        staging.waitIdle();
+    }
+
+private:
+    struct Batch {
+        uint64_t value = 0;
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+    VkDeviceSize capacity = 0;
+
+    StagingRing staging;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+    uint64_t acquiredValue = 0;
+
+    // barriers recorded by uploads that have not been submitted yet, and released batches still to be acquired.
+    Batch pending;
+    std::deque<Batch> submitted;
+};